@@ -0,0 +1,38 @@
+#include "alloc_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<std::size_t> num_allocations{0};
+thread_local alloc_counter::counts this_thread = {0, 0, 0};
+}
+
+void* operator new(std::size_t size) {
+  ++num_allocations;
+  ++this_thread.allocations;
+  this_thread.bytes_allocated += size;
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept {
+  if (p) {
+    ++this_thread.deallocations;
+  }
+  std::free(p);
+}
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
+
+namespace alloc_counter {
+
+counts thread_counts() { return this_thread; }
+
+std::size_t allocations() { return num_allocations.load(); }
+
+}  // namespace alloc_counter
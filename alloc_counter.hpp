@@ -0,0 +1,50 @@
+#ifndef INCLUDED_ALLOC_COUNTER_H
+#define INCLUDED_ALLOC_COUNTER_H
+
+#include <cstddef>
+#include <utility>
+
+// Linking alloc_counter replaces the global operator new and operator delete
+// with versions that count calls, both per thread and for the whole process.
+namespace alloc_counter {
+
+struct counts {
+  std::size_t allocations;
+  std::size_t deallocations;
+  std::size_t bytes_allocated;
+};
+
+// Counts for the calling thread since it started.
+counts thread_counts();
+
+// Number of calls to operator new in this process so far.
+std::size_t allocations();
+
+// Counts for the calling thread while f runs.
+template <typename F>
+counts count(F&& f) {
+  auto before = thread_counts();
+  std::forward<F>(f)();
+  auto after = thread_counts();
+  return {after.allocations - before.allocations,
+          after.deallocations - before.deallocations,
+          after.bytes_allocated - before.bytes_allocated};
+}
+
+}  // namespace alloc_counter
+
+// Catch assertions that the given statements do not call operator new on the
+// calling thread.
+#define ALLOC_COUNTER_NO_ALLOCATIONS(assertion, ...)                   \
+  do {                                                                 \
+    INFO("while executing: " #__VA_ARGS__);                            \
+    auto alloc_counter_counts =                                        \
+        ::alloc_counter::count([&] { __VA_ARGS__; });                  \
+    assertion(alloc_counter_counts.allocations == 0);                  \
+  } while (false)
+#define REQUIRE_NO_ALLOCATIONS(...) \
+  ALLOC_COUNTER_NO_ALLOCATIONS(REQUIRE, __VA_ARGS__)
+#define CHECK_NO_ALLOCATIONS(...) \
+  ALLOC_COUNTER_NO_ALLOCATIONS(CHECK, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef INCLUDED_BENCH_H
+#define INCLUDED_BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r"(&value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+
+// Sets value from arg if arg is "name=value".
+inline bool parse_option(const char* arg, const char* name,
+                         std::string& value) {
+  auto len = std::strlen(name);
+  if (std::strncmp(arg, name, len) == 0 && arg[len] == '=') {
+    value = arg + len + 1;
+    return true;
+  }
+  return false;
+}
+
+// std::stoul accepts "-1" and wraps it, so insist on plain digits.
+inline std::size_t parse_count(const std::string& value) {
+  if (value.empty() ||
+      value.find_first_not_of("0123456789") != std::string::npos) {
+    throw std::invalid_argument("not a count: " + value);
+  }
+  return std::stoul(value);
+}
+
+struct result {
+  std::string name;
+  std::size_t iterations;
+  double ns_per_item;
+};
+
+inline void write_json_string(std::ostream& os, const std::string& s) {
+  os << '"';
+  for (char c : s) {
+    switch (c) {
+      case '"': os << "\\\""; break;
+      case '\\': os << "\\\\"; break;
+      case '\n': os << "\\n"; break;
+      default: os << c;
+    }
+  }
+  os << '"';
+}
+
+class suite {
+ private:
+  std::chrono::nanoseconds m_min_time;
+  std::string m_filter;
+  std::vector<result> m_results;
+
+ public:
+  explicit suite(std::chrono::nanoseconds min_time = std::chrono::milliseconds(
+                     200))
+      : m_min_time(min_time) {}
+
+  // Only benchmarks whose name contains filter are run.
+  void set_filter(std::string filter) { m_filter = std::move(filter); }
+
+  bool selected(const std::string& name) const {
+    return name.find(m_filter) != std::string::npos;
+  }
+
+  // Runs f repeatedly, doubling the iteration count until a batch takes at
+  // least min_time, and records the time per item of the last batch, where
+  // each call of f processes items items.
+  template <typename F>
+  void run(std::string name, F&& f, std::size_t items = 1) {
+    if (!selected(name)) {
+      return;
+    }
+    using clock = std::chrono::steady_clock;
+    std::size_t iterations = 1;
+    for (;;) {
+      auto start = clock::now();
+      for (std::size_t i = 0; i < iterations; ++i) {
+        f();
+      }
+      auto elapsed = clock::now() - start;
+      if (elapsed >= m_min_time || iterations >= (std::size_t(1) << 40)) {
+        std::chrono::duration<double, std::nano> ns = elapsed;
+        m_results.push_back(
+            {std::move(name), iterations,
+             ns.count() / static_cast<double>(iterations * items)});
+        return;
+      }
+      iterations *= 2;
+    }
+  }
+
+  const std::vector<result>& results() const { return m_results; }
+
+  void print(std::ostream& os) const {
+    for (const auto& r : m_results) {
+      os << std::left << std::setw(48) << r.name << std::right
+         << std::setw(12) << std::fixed << std::setprecision(2) << r.ns_per_item
+         << " ns/item" << std::setw(14) << r.iterations << " iterations\n";
+    }
+  }
+
+  void write_json(std::ostream& os) const {
+    os << "{\n  \"benchmarks\": [";
+    const char* sep = "\n";
+    for (const auto& r : m_results) {
+      os << sep << "    {\"name\": ";
+      write_json_string(os, r.name);
+      os << ", \"iterations\": " << r.iterations
+         << ", \"ns_per_item\": " << std::setprecision(4) << std::fixed
+         << r.ns_per_item << "}";
+      sep = ",\n";
+    }
+    os << "\n  ]\n}\n";
+  }
+};
+
+}  // namespace bench
+
+#endif
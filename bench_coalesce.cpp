@@ -0,0 +1,141 @@
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_queues.hpp"
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::size_t robots = 1000;
+  std::size_t ticks = 1000;
+  std::size_t max_burst = 64;
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--robots", value)) {
+      opts.robots = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--ticks", value)) {
+      opts.ticks = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--max-burst", value)) {
+      opts.max_burst = bench::parse_count(value);
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.robots == 0) {
+    throw std::invalid_argument("--robots must be positive");
+  }
+  return opts;
+}
+
+// A queue that keeps every event, as robots had before.
+class plain_queue {
+ private:
+  std::deque<event> m_events;
+
+ public:
+  bool push(event&& e) {
+    m_events.push_back(std::move(e));
+    return true;
+  }
+  template <typename F>
+  std::size_t consume(F&& f) {
+    auto n = m_events.size();
+    for (auto& e : m_events) {
+      f(std::move(e));
+    }
+    m_events.clear();
+    return n;
+  }
+};
+
+struct result {
+  std::size_t events = 0;
+  std::size_t transitions = 0;
+  std::size_t peak_queued = 0;
+  double seconds = 0;
+};
+
+// On each tick every robot may get a command, then a burst of heading
+// updates from its compass, and then the robots apply what was queued.
+template <typename Queue>
+result run(const options& opts) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<std::size_t> burst(0, opts.max_burst);
+  std::uniform_int_distribution<int> command(0, 39);
+  std::uniform_real_distribution<float> angle(0, 360);
+  std::vector<Queue> queues(opts.robots);
+  std::vector<state> fleet(opts.robots, idle{});
+  result r;
+
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  for (std::size_t tick = 0; tick < opts.ticks; ++tick) {
+    std::size_t queued = 0;
+    for (auto& q : queues) {
+      switch (command(rng)) {
+        case 0: queued += q.push(turn_on{}); ++r.events; break;
+        case 1: queued += q.push(turn_off{}); ++r.events; break;
+        case 2: queued += q.push(start_turning{angle(rng)}); ++r.events; break;
+        case 3: queued += q.push(reset{"watchdog"}); ++r.events; break;
+        default: break;
+      }
+      for (auto n = burst(rng); n != 0; --n) {
+        queued += q.push(heading_changed{angle(rng)});
+        ++r.events;
+      }
+    }
+    r.peak_queued = std::max(r.peak_queued, queued);
+    for (std::size_t i = 0; i < opts.robots; ++i) {
+      r.transitions += queues[i].consume(
+          [&](event&& e) { fleet[i] = transition(fleet[i], e); });
+    }
+  }
+  r.seconds = std::chrono::duration<double>(clock::now() - start).count();
+  return r;
+}
+
+void print(const char* name, const result& r, const char* sep) {
+  std::cout << "  \"" << name << "\": {\"events\": " << r.events
+            << ", \"transitions\": " << r.transitions
+            << ", \"peak_queued\": " << r.peak_queued
+            << ", \"peak_bytes\": " << r.peak_queued * sizeof(event)
+            << ", \"seconds\": " << r.seconds << "}" << sep << "\n";
+}
+
+}  // namespace
+
+// Feeds bursts of heading updates to a fleet through plain queues and
+// through coalescing queues, and reports how many transitions and how much
+// queue space each needs.
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: bench_coalesce [--robots=N] [--ticks=N] "
+                 "[--max-burst=N]\n";
+    return 2;
+  }
+
+  auto plain = run<plain_queue>(opts);
+  auto coalescing = run<toby::coalescing_queue<event>>(opts);
+  std::cout << "{\n"
+            << "  \"robots\": " << opts.robots << ",\n"
+            << "  \"ticks\": " << opts.ticks << ",\n"
+            << "  \"max_burst\": " << opts.max_burst << ",\n";
+  print("plain", plain, ",");
+  print("coalescing", coalescing, "");
+  std::cout << "}\n";
+}
@@ -0,0 +1,102 @@
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_bench.hpp"
+#include "robot_io.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// A history dominated by runs of heading_changed, whose heading drifts by a
+// small amount each time and is reported to a hundredth of a degree.
+std::vector<event> make_history(std::size_t n) {
+  std::mt19937 rng(1);
+  auto pick = bench::heading_mix();
+  std::normal_distribution<float> drift(0, 0.05f);
+  std::uniform_real_distribution<float> angle(0, 360);
+  float heading = 180;
+  std::vector<event> events;
+  events.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    switch (pick(rng)) {
+      case 0: events.push_back(turn_on{}); break;
+      case 1: events.push_back(turn_off{}); break;
+      case 2: events.push_back(start_turning{angle(rng)}); break;
+      case 3: events.push_back(reset{"watchdog expired"}); break;
+      default:
+        heading += drift(rng);
+        events.push_back(heading_changed{std::round(heading * 100) / 100});
+        break;
+    }
+  }
+  return events;
+}
+
+}  // namespace
+
+// Compares the size of a history written with serialize and with the
+// compressed stream, and the speed of compressing and decompressing it.
+int main(int argc, char** argv) {
+  bench::suite s;
+  if (argc > 1) {
+    s.set_filter(argv[1]);
+  }
+
+  const auto events = make_history(1000000);
+
+  std::string serialized;
+  toby::writer w(serialized);
+  for (const auto& e : events) {
+    toby::serialize(w, e);
+  }
+
+  std::string compressed;
+  s.run("compress/1M",
+        [&] {
+          compressed.clear();
+          toby::compressed_encoder<event> encoder(compressed);
+          for (const auto& e : events) {
+            encoder.push(e);
+          }
+          encoder.flush();
+        },
+        events.size());
+
+  s.run("decompress/1M",
+        [&] {
+          toby::compressed_decoder<event> decoder(compressed.data(),
+                                                  compressed.size());
+          float sum = 0;
+          while (!decoder.empty()) {
+            sum += decoder.visit_next<float>(
+                [](const heading_changed& e) { return e.heading; },
+                [](const auto&) { return 0.f; });
+          }
+          bench::do_not_optimize(sum);
+        },
+        events.size());
+
+  s.run("deserialize/1M",
+        [&] {
+          toby::reader r(serialized.data(), serialized.size());
+          float sum = 0;
+          while (!r.empty()) {
+            sum += toby::deserialize<event>(r).visit<float>(
+                [](const heading_changed& e) { return e.heading; },
+                [](const auto&) { return 0.f; });
+          }
+          bench::do_not_optimize(sum);
+        },
+        events.size());
+
+  s.print(std::cerr);
+  s.write_json(std::cout);
+  std::cerr << "serialized bytes per event: "
+            << static_cast<double>(serialized.size()) / events.size() << "\n"
+            << "compressed bytes per event: "
+            << static_cast<double>(compressed.size()) / events.size() << "\n";
+}
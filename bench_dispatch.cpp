@@ -0,0 +1,134 @@
+#include "bench.hpp"
+#include "variant.hpp"
+
+#include <random>
+#include <utility>
+#include <vector>
+
+using toby::variant;
+
+template <std::size_t N>
+struct alt {
+  int value;
+};
+
+template <typename Is>
+struct make_alts_variant;
+
+template <std::size_t... I>
+struct make_alts_variant<std::index_sequence<I...>> {
+  using type = variant<alt<I>...>;
+};
+
+template <std::size_t N>
+using alts_variant =
+    typename make_alts_variant<std::make_index_sequence<N>>::type;
+
+// Each alternative does something different so that the compiler cannot
+// collapse the dispatch into arithmetic on the tag.
+struct sum_visitor {
+  template <std::size_t N>
+  int operator()(const alt<N>& a) const {
+    switch (N % 4) {
+      case 0: return a.value + static_cast<int>(N);
+      case 1: return a.value * static_cast<int>(N);
+      case 2: return a.value ^ static_cast<int>(N);
+      default: return a.value >> (N % 7);
+    }
+  }
+};
+
+template <typename V>
+struct recursive_dispatch;
+
+template <typename... Ts>
+struct recursive_dispatch<variant<Ts...>> {
+  template <typename R, typename F>
+  static R visit(const variant<Ts...>& v, F&& f) {
+    using tag_type = std::decay_t<decltype(v.tag)>;
+    return toby::detail::variant_visit<tag_type, 0, Ts...>::
+        template visit_helper_const<R>(v.tag, &v.storage, std::forward<F>(f));
+  }
+};
+
+template <typename V>
+struct table_dispatch;
+
+template <typename... Ts>
+struct table_dispatch<variant<Ts...>> {
+  template <typename R, typename F, typename T>
+  static R call(const void* storage, F& f) {
+    return f(*reinterpret_cast<const T*>(storage));
+  }
+
+  template <typename R, typename F>
+  static R visit(const variant<Ts...>& v, F&& f) {
+    using fn = R (*)(const void*, F&);
+    static constexpr fn table[] = {&call<R, F, Ts>...};
+    return table[v.tag](&v.storage, f);
+  }
+};
+
+struct switch_dispatch {
+  template <typename R, typename V, typename F>
+  static R visit(const V& v, F&& f) {
+    return v.template visit<R>(std::forward<F>(f));
+  }
+};
+
+template <std::size_t N, std::size_t I>
+alts_variant<N> make_one(int value) {
+  return alt<I>{value};
+}
+
+template <std::size_t N, std::size_t... I>
+alts_variant<N> make_alt(std::size_t k, int value, std::index_sequence<I...>) {
+  using factory = alts_variant<N> (*)(int);
+  static constexpr factory factories[] = {&make_one<N, I>...};
+  return factories[k](value);
+}
+
+template <std::size_t N>
+std::vector<alts_variant<N>> make_input(std::size_t size) {
+  std::vector<alts_variant<N>> input;
+  input.reserve(size);
+  std::mt19937 rng(N);
+  std::uniform_int_distribution<std::size_t> pick(0, N - 1);
+  for (std::size_t i = 0; i < size; ++i) {
+    input.push_back(make_alt<N>(pick(rng), static_cast<int>(i),
+                                std::make_index_sequence<N>()));
+  }
+  return input;
+}
+
+template <typename Dispatch, std::size_t N>
+void run_dispatch(bench::suite& s, const char* strategy) {
+  auto input = make_input<N>(1 << 18);
+  s.run(std::string(strategy) + "/" + std::to_string(N),
+        [&] {
+          int sum = 0;
+          for (const auto& v : input) {
+            sum += Dispatch::template visit<int>(v, sum_visitor{});
+          }
+          bench::do_not_optimize(sum);
+        },
+        input.size());
+}
+
+template <std::size_t N>
+void run_all(bench::suite& s) {
+  run_dispatch<switch_dispatch, N>(s, "switch");
+  run_dispatch<recursive_dispatch<alts_variant<N>>, N>(s, "recursive");
+  run_dispatch<table_dispatch<alts_variant<N>>, N>(s, "table");
+}
+
+int main() {
+  bench::suite s;
+  run_all<2>(s);
+  run_all<4>(s);
+  run_all<8>(s);
+  run_all<16>(s);
+  run_all<32>(s);
+  run_all<64>(s);
+  s.print(std::cout);
+}
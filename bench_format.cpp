@@ -0,0 +1,59 @@
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_bench.hpp"
+#include "robot_format.hpp"
+
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Formats a million events, one log line each, into an in-memory buffer the
+// way a log sink receives them: through iostreams and through the native fmt
+// formatter.
+int main(int argc, char** argv) {
+  bench::suite s;
+  if (argc > 1) {
+    s.set_filter(argv[1]);
+  }
+
+  const auto events = bench::make_events(1000000, {1, 1, 1, 1, 1});
+
+  std::ostringstream os;
+  s.run("ostream/1M",
+        [&] {
+          os.str(std::string());
+          for (const auto& e : events) {
+            os << "event = " << e << '\n';
+          }
+          bench::do_not_optimize(os);
+        },
+        events.size());
+
+#if FMT_VERSION >= 50000
+  fmt::memory_buffer buffer;
+  s.run("fmt/1M",
+        [&] {
+          buffer.clear();
+          for (const auto& e : events) {
+            fmt::format_to(std::back_inserter(buffer), "event = {}\n", e);
+          }
+          bench::do_not_optimize(buffer);
+        },
+        events.size());
+#else
+  fmt::MemoryWriter writer;
+  s.run("fmt/1M",
+        [&] {
+          writer.clear();
+          for (const auto& e : events) {
+            writer.write("event = {}\n", e);
+          }
+          bench::do_not_optimize(writer);
+        },
+        events.size());
+#endif
+
+  s.write_json(std::cout);
+}
@@ -0,0 +1,167 @@
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_queues.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::size_t rounds = 2000;
+  std::size_t arrivals = 1100;
+  std::size_t service = 1000;
+  std::size_t urgent_permille = 10;
+  std::size_t robots = 1000;
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--rounds", value)) {
+      opts.rounds = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--arrivals", value)) {
+      opts.arrivals = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--service", value)) {
+      opts.service = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--urgent-permille", value)) {
+      opts.urgent_permille = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--robots", value)) {
+      opts.robots = bench::parse_count(value);
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.robots == 0 || opts.urgent_permille > 1000) {
+    throw std::invalid_argument(
+        "--robots must be positive and --urgent-permille at most 1000");
+  }
+  return opts;
+}
+
+// One FIFO for everything, as queues were before, with the same metrics as
+// lane_queue keeps per lane.
+class fifo {
+ private:
+  using clock = std::chrono::steady_clock;
+  std::deque<std::pair<event, clock::time_point>> m_events;
+  toby::lane_stats m_stats[2];
+
+  static std::size_t lane_of(const event& e) {
+    return e.visit<std::size_t>([](const auto& alternative) {
+      return toby::priority_lane<std::decay_t<decltype(alternative)>>::value;
+    });
+  }
+
+ public:
+  void push(event&& e) {
+    auto& s = m_stats[lane_of(e)];
+    ++s.pushed;
+    s.peak_depth = std::max(s.peak_depth, ++s.depth);
+    m_events.emplace_back(std::move(e), clock::now());
+  }
+
+  template <typename F>
+  std::size_t consume(F&& f, std::size_t max) {
+    std::size_t n = 0;
+    for (; n != max && !m_events.empty(); ++n) {
+      auto& front = m_events.front();
+      auto& s = m_stats[lane_of(front.first)];
+      s.latency.record(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              clock::now() - front.second)
+              .count()));
+      ++s.popped;
+      --s.depth;
+      f(std::move(front.first));
+      m_events.pop_front();
+    }
+    return n;
+  }
+
+  const toby::lane_stats& stats(std::size_t lane) const {
+    return m_stats[lane];
+  }
+};
+
+// Each round queues more events than the consumer then takes, so the
+// backlog grows for the whole run.
+template <typename Queue>
+void run(const options& opts, Queue& queue) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<std::size_t> permille(0, 999);
+  std::uniform_real_distribution<float> angle(0, 360);
+  std::vector<state> fleet(opts.robots, idle{});
+  std::size_t robot = 0;
+  for (std::size_t round = 0; round < opts.rounds; ++round) {
+    for (std::size_t i = 0; i < opts.arrivals; ++i) {
+      if (permille(rng) < opts.urgent_permille) {
+        if (i % 2) {
+          queue.push(event(turn_off{}));
+        } else {
+          queue.push(event(reset{"watchdog"}));
+        }
+      } else {
+        queue.push(event(heading_changed{angle(rng)}));
+      }
+    }
+    queue.consume(
+        [&](event&& e) {
+          fleet[robot] = transition(fleet[robot], e);
+          if (++robot == fleet.size()) robot = 0;
+        },
+        opts.service);
+  }
+}
+
+template <typename Queue>
+void print(const char* name, const Queue& queue, const char* sep) {
+  const auto& urgent = queue.stats(1);
+  const auto& other = queue.stats(0);
+  std::cout << "  \"" << name << "\": {"
+            << "\"urgent_p50_ns\": " << urgent.latency.percentile(0.5)
+            << ", \"urgent_p99_ns\": " << urgent.latency.percentile(0.99)
+            << ", \"urgent_served\": " << urgent.popped
+            << ", \"other_p99_ns\": " << other.latency.percentile(0.99)
+            << ", \"other_served\": " << other.popped
+            << ", \"other_peak_depth\": " << other.peak_depth
+            << "}" << sep << "\n";
+}
+
+}  // namespace
+
+// Overloads a robot's event queue with heading updates and a few safety
+// events, and reports how long the safety events wait in a single FIFO and
+// in a lane_queue.
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: bench_lanes [--rounds=N] [--arrivals=N] "
+                 "[--service=N] [--urgent-permille=N] [--robots=N]\n";
+    return 2;
+  }
+
+  fifo plain;
+  run(opts, plain);
+  toby::lane_queue<event> lanes;
+  run(opts, lanes);
+  std::cout << "{\n"
+            << "  \"rounds\": " << opts.rounds << ",\n"
+            << "  \"arrivals\": " << opts.arrivals << ",\n"
+            << "  \"service\": " << opts.service << ",\n"
+            << "  \"urgent_permille\": " << opts.urgent_permille << ",\n";
+  print("fifo", plain, ",");
+  print("lane_queue", lanes, "");
+  std::cout << "}\n";
+}
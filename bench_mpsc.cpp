@@ -0,0 +1,198 @@
+#include "bench.hpp"
+#include "mpsc_ring.hpp"
+#include "robot.hpp"
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::size_t events = 10000000;
+  std::size_t max_producers = 64;
+  std::size_t capacity = 1 << 14;
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--events", value)) {
+      opts.events = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--max-producers", value)) {
+      opts.max_producers = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--capacity", value)) {
+      opts.capacity = bench::parse_count(value);
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.max_producers == 0) {
+    throw std::invalid_argument("--max-producers must be positive");
+  }
+  return opts;
+}
+
+// The events without reset, whose string makes event non-trivial.
+using compact_event =
+    toby::variant<turn_on, turn_off, start_turning, heading_changed>;
+
+// What producers share today: a deque behind a mutex, which the consumer
+// swaps out to drain in batches.
+template <typename Event>
+class locked_queue {
+ private:
+  std::mutex m_mutex;
+  std::deque<Event> m_events;
+  std::size_t m_capacity;
+
+ public:
+  explicit locked_queue(std::size_t capacity) : m_capacity(capacity) {}
+
+  bool try_push(Event&& e) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_events.size() == m_capacity) {
+      return false;
+    }
+    m_events.push_back(std::move(e));
+    return true;
+  }
+
+  template <typename F>
+  std::size_t consume(F&& f, std::size_t max) {
+    std::deque<Event> batch;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_events.size() <= max) {
+        batch.swap(m_events);
+      } else {
+        for (std::size_t i = 0; i < max; ++i) {
+          batch.push_back(std::move(m_events.front()));
+          m_events.pop_front();
+        }
+      }
+    }
+    for (auto& e : batch) {
+      std::move(e).template visit<void>(f);
+    }
+    return batch.size();
+  }
+};
+
+struct sum_visitor {
+  double& sum;
+  void operator()(turn_on&&) const { sum += 1; }
+  void operator()(turn_off&&) const { sum -= 1; }
+  void operator()(start_turning&& e) const { sum += e.target; }
+  void operator()(reset&& e) const { sum += e.reason.size(); }
+  void operator()(heading_changed&& e) const { sum += e.heading; }
+};
+
+template <typename Event>
+Event make_event(std::size_t i);
+
+template <>
+event make_event<event>(std::size_t i) {
+  switch (i % 8) {
+    case 0: return turn_on{};
+    case 1: return turn_off{};
+    case 2: return reset{"watchdog"};
+    case 3: return start_turning{static_cast<float>(i % 360)};
+    default: return heading_changed{static_cast<float>(i % 360)};
+  }
+}
+template <>
+compact_event make_event<compact_event>(std::size_t i) {
+  switch (i % 8) {
+    case 0: return turn_on{};
+    case 1: return turn_off{};
+    case 2:
+    case 3: return start_turning{static_cast<float>(i % 360)};
+    default: return heading_changed{static_cast<float>(i % 360)};
+  }
+}
+
+// Pushes opts.events events from the producer threads, each an equal share,
+// and returns how many per second the consumer visited.
+template <typename Event, typename Queue>
+double run(const options& opts, std::size_t producers) {
+  Queue queue(opts.capacity);
+  const auto per_producer = opts.events / producers;
+  const auto total = per_producer * producers;
+  double sum = 0;
+
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  std::vector<std::thread> threads;
+  for (std::size_t p = 0; p < producers; ++p) {
+    threads.emplace_back([&queue, per_producer, p] {
+      for (std::size_t i = 0; i < per_producer; ++i) {
+        auto e = make_event<Event>(p + i);
+        while (!queue.try_push(std::move(e))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (std::size_t received = 0; received < total;) {
+    auto n = queue.consume(sum_visitor{sum}, 256);
+    if (n == 0) {
+      std::this_thread::yield();
+    }
+    received += n;
+  }
+  auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+  for (auto& t : threads) {
+    t.join();
+  }
+  bench::do_not_optimize(sum);
+  return total / seconds;
+}
+
+}  // namespace
+
+// Pushes events from 1, 2, 4, ... up to 64 producer threads to one
+// consumer through a locked deque and through mpsc_ring, for event and for
+// a variant of trivially copyable events, and reports events per second.
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: bench_mpsc [--events=N] [--max-producers=N] "
+                 "[--capacity=N]\n";
+    return 2;
+  }
+
+  std::vector<std::size_t> producer_counts;
+  for (std::size_t n = 1; n < opts.max_producers; n *= 2) {
+    producer_counts.push_back(n);
+  }
+  producer_counts.push_back(opts.max_producers);
+
+  std::cout << "{\n"
+            << "  \"events\": " << opts.events << ",\n"
+            << "  \"capacity\": " << opts.capacity << ",\n"
+            << "  \"cores\": " << std::thread::hardware_concurrency() << ",\n"
+            << "  \"runs\": [";
+  const char* sep = "\n";
+  for (auto producers : producer_counts) {
+    auto locked = run<event, locked_queue<event>>(opts, producers);
+    auto ring = run<event, toby::mpsc_ring<event>>(opts, producers);
+    auto compact =
+        run<compact_event, toby::mpsc_ring<compact_event>>(opts, producers);
+    std::cout << sep << "    {\"producers\": " << producers
+              << ", \"locked_deque_per_second\": " << locked
+              << ", \"mpsc_ring_per_second\": " << ring
+              << ", \"mpsc_ring_trivial_per_second\": " << compact << "}";
+    sep = ",\n";
+  }
+  std::cout << "\n  ]\n}\n";
+}
@@ -0,0 +1,183 @@
+#include "bench.hpp"
+#include "parallel.hpp"
+#include "variant.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::size_t elements = 50000000;
+  std::size_t heavy_percent = 5;
+  std::size_t max_threads = std::thread::hardware_concurrency();
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--elements", value)) {
+      opts.elements = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--heavy-percent", value)) {
+      opts.heavy_percent = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--max-threads", value)) {
+      opts.max_threads = bench::parse_count(value);
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.heavy_percent > 100) {
+    throw std::invalid_argument("--heavy-percent must be at most 100");
+  }
+  if (opts.max_threads == 0) {
+    opts.max_threads = 1;
+  }
+  return opts;
+}
+
+struct light {
+  std::uint32_t value;
+};
+
+struct heavy {
+  std::uint32_t seed;
+};
+
+using element = toby::variant<light, heavy>;
+
+struct cost {
+  std::uint64_t operator()(const light& l) const { return l.value; }
+  std::uint64_t operator()(const heavy& h) const {
+    std::uint64_t x = h.seed | 1;
+    for (int i = 0; i < 512; ++i) {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+    }
+    return x & 0xffff;
+  }
+};
+
+// Heavy elements are bunched into the first part of the vector, as they are
+// when related records are stored together, so that an even split of the
+// indexes is an uneven split of the work.
+std::vector<element> make_elements(const options& opts) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<std::uint32_t> value(0, 1000);
+  std::uniform_int_distribution<std::size_t> percent(0, 99);
+  const auto bunch = opts.elements / 5;
+  std::vector<element> elements;
+  elements.reserve(opts.elements);
+  for (std::size_t i = 0; i < opts.elements; ++i) {
+    bool is_heavy = i < bunch && percent(rng) < 5 * opts.heavy_percent;
+    if (is_heavy) {
+      elements.push_back(heavy{value(rng)});
+    } else {
+      elements.push_back(light{value(rng)});
+    }
+  }
+  return elements;
+}
+
+std::uint64_t sum(const element* first, const element* last) {
+  std::uint64_t total = 0;
+  for (; first != last; ++first) {
+    total += first->visit<std::uint64_t>(cost{});
+  }
+  return total;
+}
+
+// What callers did before parallel_reduce: one thread per equal slice.
+std::uint64_t static_sum(const std::vector<element>& elements,
+                         std::size_t threads) {
+  std::vector<std::uint64_t> partials(threads);
+  std::vector<std::thread> workers;
+  const auto n = elements.size();
+  for (std::size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      partials[t] = sum(elements.data() + n * t / threads,
+                        elements.data() + n * (t + 1) / threads);
+    });
+  }
+  std::uint64_t total = 0;
+  for (std::size_t t = 0; t < threads; ++t) {
+    workers[t].join();
+    total += partials[t];
+  }
+  return total;
+}
+
+template <typename F>
+double time(F&& f, std::uint64_t expected) {
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  auto result = f();
+  auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+  if (result != expected) {
+    throw std::logic_error("wrong sum");
+  }
+  return seconds;
+}
+
+}  // namespace
+
+// Sums a mix of cheap and expensive alternatives with a single-threaded
+// visit loop, with one thread per equal slice, and with parallel_reduce, on
+// 1, 2, 4, ... threads up to one per core.
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: bench_parallel [--elements=N] [--heavy-percent=N] "
+                 "[--max-threads=N]\n";
+    return 2;
+  }
+
+  const auto elements = make_elements(opts);
+  const auto first = elements.data();
+  const auto last = first + elements.size();
+  const auto expected = sum(first, last);
+  const auto serial = time([&] { return sum(first, last); }, expected);
+
+  std::vector<std::size_t> thread_counts;
+  for (std::size_t n = 1; n < opts.max_threads; n *= 2) {
+    thread_counts.push_back(n);
+  }
+  thread_counts.push_back(opts.max_threads);
+
+  std::cout << "{\n"
+            << "  \"elements\": " << opts.elements << ",\n"
+            << "  \"heavy_percent\": " << opts.heavy_percent << ",\n"
+            << "  \"cores\": " << std::thread::hardware_concurrency() << ",\n"
+            << "  \"serial_seconds\": " << serial << ",\n"
+            << "  \"runs\": [";
+  const char* sep = "\n";
+  for (auto threads : thread_counts) {
+    auto slices =
+        time([&] { return static_sum(elements, threads); }, expected);
+    toby::thread_pool pool(threads);
+    auto reduce = time(
+        [&] {
+          return toby::parallel_reduce(
+              pool, first, last, std::uint64_t(0), cost{},
+              [](std::uint64_t a, std::uint64_t b) { return a + b; });
+        },
+        expected);
+    std::cout << sep << "    {\"threads\": " << threads
+              << ", \"static_seconds\": " << slices
+              << ", \"static_speedup\": " << serial / slices
+              << ", \"parallel_reduce_seconds\": " << reduce
+              << ", \"parallel_reduce_speedup\": " << serial / reduce << "}";
+    sep = ",\n";
+  }
+  std::cout << "\n  ]\n}\n";
+}
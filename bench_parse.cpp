@@ -0,0 +1,136 @@
+#include "alloc_counter.hpp"
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_bench.hpp"
+#include "robot_io.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+std::string make_text(std::size_t n) {
+  std::mt19937 rng(1);
+  auto pick = bench::heading_mix();
+  std::uniform_real_distribution<float> angle(0, 360);
+  std::string text;
+  char line[64];
+  for (std::size_t i = 0; i < n; ++i) {
+    switch (pick(rng)) {
+      case 0: text += "turn_on\n"; break;
+      case 1: text += "turn_off\n"; break;
+      case 2:
+        std::snprintf(line, sizeof(line), "start_turning %.2f\n", angle(rng));
+        text += line;
+        break;
+      case 3: text += "reset \"watchdog expired\"\n"; break;
+      default:
+        std::snprintf(line, sizeof(line), "heading_changed %.2f\n",
+                      angle(rng));
+        text += line;
+        break;
+    }
+  }
+  return text;
+}
+
+// The obvious parser: a stream per line and a map from names to factories.
+std::size_t parse_with_streams(const std::string& text, event* out) {
+  using factory = event (*)(std::istream&);
+  static const std::unordered_map<std::string, factory> factories = {
+      {"turn_on", [](std::istream&) -> event { return turn_on{}; }},
+      {"turn_off", [](std::istream&) -> event { return turn_off{}; }},
+      {"start_turning",
+       [](std::istream& is) -> event {
+         start_turning e;
+         is >> e.target;
+         return e;
+       }},
+      {"reset",
+       [](std::istream& is) -> event {
+         reset e;
+         is >> std::ws;
+         std::getline(is, e.reason);
+         e.reason = e.reason.substr(1, e.reason.size() - 2);
+         return e;
+       }},
+      {"heading_changed", [](std::istream& is) -> event {
+         heading_changed e;
+         is >> e.heading;
+         return e;
+       }}};
+  std::istringstream in(text);
+  std::string line;
+  std::size_t n = 0;
+  while (std::getline(in, line)) {
+    std::istringstream is(line);
+    std::string name;
+    is >> name;
+    out[n++] = factories.at(name)(is);
+  }
+  return n;
+}
+
+}  // namespace
+
+// Parses a stream of event lines, delivered in 64 KiB chunks, into batches of
+// events, with text_parser and with iostreams.
+int main(int argc, char** argv) {
+  bench::suite s;
+  if (argc > 1) {
+    s.set_filter(argv[1]);
+  }
+
+  const std::size_t lines = 1000000;
+  const auto text = make_text(lines);
+  std::vector<event> events(lines, turn_on{});
+
+  const std::size_t chunk = 64 << 10;
+  const std::size_t batch = 4096;
+  std::size_t allocations = 0;
+  s.run("text_parser/1M",
+        [&] {
+          toby::text_parser<event> parser;
+          std::size_t n = 0;
+          auto counts = alloc_counter::count([&] {
+            for (std::size_t i = 0; i < text.size(); i += chunk) {
+              const char* p = text.data() + i;
+              const char* last =
+                  text.data() + std::min(i + chunk, text.size());
+              while (p != last) {
+                auto r = parser.parse(p, last, &events[n],
+                                      std::min(batch, lines - n));
+                n += r.count;
+                p = r.ptr;
+              }
+            }
+          });
+          allocations = counts.allocations;
+          bench::do_not_optimize(n);
+        },
+        lines);
+  auto text_parser_allocations = allocations;
+
+  s.run("iostream/1M",
+        [&] {
+          auto counts = alloc_counter::count([&] {
+            bench::do_not_optimize(parse_with_streams(text, &events[0]));
+          });
+          allocations = counts.allocations;
+        },
+        lines);
+
+  s.print(std::cerr);
+  s.write_json(std::cout);
+  std::cerr << "text_parser allocations per event: "
+            << static_cast<double>(text_parser_allocations) / lines << "\n"
+            << "iostream allocations per event: "
+            << static_cast<double>(allocations) / lines << "\n"
+            << "MB of text: " << text.size() / 1e6 << "\n";
+}
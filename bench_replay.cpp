@@ -0,0 +1,148 @@
+#include "bench.hpp"
+#include "event_log.hpp"
+#include "robot.hpp"
+#include "robot_bench.hpp"
+#include "robot_io.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+struct options {
+  std::size_t events = 100000000;
+  std::size_t segment_size = 64 << 20;
+  std::string dir = "/tmp";
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--events", value)) {
+      opts.events = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--segment-size", value)) {
+      opts.segment_size = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--dir", value)) {
+      opts.dir = value;
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.segment_size == 0) {
+    throw std::invalid_argument("--segment-size must be positive");
+  }
+  return opts;
+}
+
+void remove_log(const std::string& dir) {
+  for (auto kind : {std::make_pair("segment", "log"),
+                    std::make_pair("snapshot", "state")}) {
+    for (const auto& f :
+         toby::detail::list_log_files(dir, kind.first, kind.second)) {
+      std::remove(f.second.c_str());
+    }
+  }
+  ::rmdir(dir.c_str());
+}
+
+std::size_t log_bytes(const std::string& dir) {
+  std::size_t bytes = 0;
+  for (const auto& f : toby::detail::list_log_files(dir, "segment", "log")) {
+    bytes += toby::mapped_file(f.second).size();
+  }
+  return bytes;
+}
+
+// Compares the alternative and its payload, such as a turning robot's target.
+bool same_state(const state& a, const state& b) {
+  return toby::serialize(a) == toby::serialize(b);
+}
+
+}  // namespace
+
+// Appends a robot's event history to a log, then rebuilds its state by
+// replaying the whole log, and again from a snapshot followed by a short
+// tail of events.
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: bench_replay [--events=N] [--segment-size=BYTES] "
+                 "[--dir=PATH]\n";
+    return 2;
+  }
+
+  std::string dir = opts.dir + "/bench_replay.XXXXXX";
+  if (!::mkdtemp(&dir[0])) {
+    std::perror(dir.c_str());
+    return 1;
+  }
+
+  // A prime number of events so that the history does not repeat with the
+  // period of the state machine.
+  const auto events = bench::make_events(65521);
+  const std::size_t tail = opts.events / 100;
+  auto step = [](const state& s, const event& e) { return transition(s, e); };
+
+  using clock = std::chrono::steady_clock;
+  using seconds = std::chrono::duration<double>;
+  state live{off{}};
+  std::size_t next_event = 0;
+  auto append = [&](toby::event_log<event>& log, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      log.append(events[next_event]);
+      live = transition(live, events[next_event]);
+      if (++next_event == events.size()) next_event = 0;
+    }
+    log.flush();
+  };
+
+  toby::event_log<event> log(dir, opts.segment_size);
+  auto start = clock::now();
+  append(log, opts.events);
+  auto append_seconds = seconds(clock::now() - start).count();
+  auto bytes = log_bytes(dir);
+
+  start = clock::now();
+  auto replayed = toby::replay<event>(dir, state{off{}}, step);
+  auto replay_seconds = seconds(clock::now() - start).count();
+  bool ok = same_state(replayed, live);
+
+  log.snapshot(live);
+  append(log, tail);
+  start = clock::now();
+  replayed = toby::replay<event>(dir, state{off{}}, step);
+  auto snapshot_seconds = seconds(clock::now() - start).count();
+  ok = ok && same_state(replayed, live);
+
+  remove_log(dir);
+  if (!ok) {
+    std::cerr << "replayed state does not match live state\n";
+    return 1;
+  }
+
+  std::cout << "{\n"
+            << "  \"events\": " << opts.events << ",\n"
+            << "  \"log_bytes\": " << bytes << ",\n"
+            << "  \"append_seconds\": " << append_seconds << ",\n"
+            << "  \"append_events_per_second\": "
+            << opts.events / append_seconds << ",\n"
+            << "  \"replay_seconds\": " << replay_seconds << ",\n"
+            << "  \"replay_events_per_second\": "
+            << opts.events / replay_seconds << ",\n"
+            << "  \"replay_bytes_per_second\": " << bytes / replay_seconds
+            << ",\n"
+            << "  \"snapshot_tail_events\": " << tail << ",\n"
+            << "  \"snapshot_replay_seconds\": " << snapshot_seconds << "\n"
+            << "}\n";
+}
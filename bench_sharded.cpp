@@ -0,0 +1,126 @@
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_bench.hpp"
+#include "sharded_runtime.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::size_t robots = 200000;
+  std::size_t transitions = 20000000;
+  std::size_t producers = 2;
+  std::size_t max_shards = std::thread::hardware_concurrency();
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--robots", value)) {
+      opts.robots = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--transitions", value)) {
+      opts.transitions = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--producers", value)) {
+      opts.producers = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--max-shards", value)) {
+      opts.max_shards = bench::parse_count(value);
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.robots == 0 || opts.producers == 0) {
+    throw std::invalid_argument("--robots and --producers must be positive");
+  }
+  if (opts.max_shards == 0) {
+    opts.max_shards = 1;
+  }
+  return opts;
+}
+
+struct step {
+  state operator()(const state& s, const event& e) const {
+    return transition(s, e);
+  }
+};
+
+// Sends transitions events round robin over the robots from the producer
+// threads, each taking an equal share of the robots, and returns the time
+// until the shards have applied them all.
+double run(const options& opts, std::size_t shards,
+           const std::vector<event>& events) {
+  using clock = std::chrono::steady_clock;
+  toby::sharded_runtime<state, event, step> runtime(opts.robots, shards,
+                                                    opts.producers, off{});
+  auto start = clock::now();
+  std::vector<std::thread> producers;
+  for (std::size_t p = 0; p < opts.producers; ++p) {
+    producers.emplace_back([&, p] {
+      auto producer = runtime.make_producer(p);
+      auto n = opts.transitions / opts.producers;
+      std::size_t next_event = p;
+      for (std::size_t i = 0; i < n; ++i) {
+        auto robot = (p + i * opts.producers) % opts.robots;
+        producer.send(robot, events[next_event]);
+        if (++next_event == events.size()) next_event = 0;
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  runtime.stop();
+  return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+}  // namespace
+
+// Drives a robot fleet through sharded_runtime with 1, 2, 4, ... shard
+// threads, up to one per core, and reports how throughput scales.
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: bench_sharded [--robots=N] [--transitions=N] "
+                 "[--producers=N] [--max-shards=N]\n";
+    return 2;
+  }
+
+  const auto events = bench::make_events(65521);
+  std::vector<std::size_t> shard_counts;
+  for (std::size_t n = 1; n < opts.max_shards; n *= 2) {
+    shard_counts.push_back(n);
+  }
+  shard_counts.push_back(opts.max_shards);
+
+  const auto transitions = opts.transitions / opts.producers * opts.producers;
+  double base = 0;
+  std::cout << "{\n"
+            << "  \"robots\": " << opts.robots << ",\n"
+            << "  \"transitions\": " << transitions << ",\n"
+            << "  \"producers\": " << opts.producers << ",\n"
+            << "  \"cores\": " << std::thread::hardware_concurrency() << ",\n"
+            << "  \"runs\": [";
+  const char* sep = "\n";
+  for (auto shards : shard_counts) {
+    auto seconds = run(opts, shards, events);
+    auto rate = transitions / seconds;
+    if (base == 0) {
+      base = rate;
+    }
+    std::cout << sep << "    {\"shards\": " << shards
+              << ", \"seconds\": " << seconds
+              << ", \"transitions_per_second\": " << rate
+              << ", \"speedup\": " << rate / base << "}";
+    sep = ",\n";
+  }
+  std::cout << "\n  ]\n}\n";
+}
@@ -0,0 +1,69 @@
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_bench.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Only start_turning and heading_changed on a turning robot need the
+// multivisitor.
+void run_mix(bench::suite& s, const std::string& mix,
+             std::discrete_distribution<int> pick) {
+  const std::size_t n = 1 << 12;
+  const auto events = bench::make_events(n, pick);
+  std::vector<state> fleet(n, idle{});
+  s.run("multivisitor/" + mix,
+        [&] {
+          for (std::size_t i = 0; i < n; ++i) {
+            fleet[i] = transition(fleet[i], events[i]);
+          }
+          bench::do_not_optimize(fleet);
+        },
+        n);
+  s.run("tag_table/" + mix,
+        [&] {
+          transition_tags::apply(fleet.data(), events.data(), n, transition);
+          bench::do_not_optimize(fleet);
+        },
+        n);
+}
+
+}  // namespace
+
+// Applies a million events to a million robots, one each, with the
+// multivisitor alone and with transition_tags in front of it, then resolves
+// bare tag arrays to show the cost of the table lookup itself.
+int main(int argc, char** argv) {
+  bench::suite s;
+  if (argc > 1) {
+    s.set_filter(argv[1]);
+  }
+  run_mix(s, "tags_only", {1, 1, 0, 0, 0});
+  run_mix(s, "uniform", {1, 1, 1, 1, 1});
+  run_mix(s, "heading", bench::heading_mix());
+
+  const std::size_t n = 1 << 20;
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<int> state_tag(0, 2);
+  std::uniform_int_distribution<int> event_tag(0, 4);
+  std::vector<std::uint8_t> state_tags(n);
+  std::vector<std::uint8_t> event_tags(n);
+  std::vector<std::uint8_t> results(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    state_tags[i] = static_cast<std::uint8_t>(state_tag(rng));
+    event_tags[i] = static_cast<std::uint8_t>(event_tag(rng));
+  }
+  s.run("resolve",
+        [&] {
+          transition_tags::resolve(state_tags.data(), event_tags.data(),
+                                   results.data(), n);
+          bench::do_not_optimize(results);
+        },
+        n);
+  s.write_json(std::cout);
+}
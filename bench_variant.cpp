@@ -0,0 +1,433 @@
+#include "bench.hpp"
+#include "multivisitor.hpp"
+#include "relocate.hpp"
+#include "svu.hpp"
+#include "variant.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Trivially copyable alternative of Size bytes; I distinguishes the
+// alternatives of a variant from each other.
+template <std::size_t I, std::size_t Size>
+struct payload {
+  unsigned char bytes[Size];
+
+  explicit payload(int value) {
+    std::memset(bytes, 0, Size);
+    bytes[0] = static_cast<unsigned char>(value);
+  }
+};
+
+template <typename T>
+struct type_tag {};
+
+template <std::size_t I, std::size_t Size>
+payload<I, Size> sample(type_tag<payload<I, Size>>, int value) {
+  return payload<I, Size>(value);
+}
+inline std::string sample(type_tag<std::string>, int value) {
+  return std::string(32, static_cast<char>('a' + value % 26));
+}
+inline std::vector<int> sample(type_tag<std::vector<int>>, int value) {
+  return std::vector<int>(8, value);
+}
+
+template <std::size_t I, std::size_t Size>
+int value_of(const payload<I, Size>& p) {
+  return p.bytes[0] + static_cast<int>(I);
+}
+inline int value_of(const std::string& s) { return s[0]; }
+inline int value_of(const std::vector<int>& v) { return v[0]; }
+
+struct value_visitor {
+  template <typename T>
+  int operator()(const T& x) const {
+    return value_of(x);
+  }
+};
+
+struct pair_visitor {
+  template <typename T, typename U>
+  int operator()(const T& x, const U& y) const {
+    return value_of(x) - value_of(y);
+  }
+};
+
+// Virtual-class baseline: a value type owning a heap-allocated holder,
+// visited with the classic double-dispatch visitor pattern.
+template <typename... Ts>
+class poly {
+ public:
+  template <typename T>
+  struct visitor_base {
+    virtual int visit(const T&) const = 0;
+
+   protected:
+    ~visitor_base() = default;
+  };
+
+  struct visitor : visitor_base<Ts>... {};
+
+ private:
+  struct base {
+    virtual ~base() {}
+    virtual std::unique_ptr<base> clone() const = 0;
+    virtual int accept(const visitor& v) const = 0;
+  };
+
+  template <typename T>
+  struct holder final : base {
+    T value;
+
+    explicit holder(T v) : value(std::move(v)) {}
+    std::unique_ptr<base> clone() const override {
+      return std::make_unique<holder>(value);
+    }
+    int accept(const visitor& v) const override {
+      return static_cast<const visitor_base<T>&>(v).visit(value);
+    }
+  };
+
+  std::unique_ptr<base> m_impl;
+
+ public:
+  template <typename T, typename = std::enable_if_t<
+                            !std::is_same<std::decay_t<T>, poly>::value>>
+  poly(T&& value)
+      : m_impl(std::make_unique<holder<std::decay_t<T>>>(
+            std::forward<T>(value))) {}
+
+  poly(const poly& other) : m_impl(other.m_impl->clone()) {}
+  poly(poly&&) = default;
+  poly& operator=(const poly& other) {
+    m_impl = other.m_impl->clone();
+    return *this;
+  }
+  poly& operator=(poly&&) = default;
+
+  int accept(const visitor& v) const { return m_impl->accept(v); }
+};
+
+// Implements visitor_base<T>::visit for each T by calling Derived::f.
+template <typename Derived, typename Base, typename... Ts>
+struct poly_visit_all;
+
+template <typename Derived, typename Base>
+struct poly_visit_all<Derived, Base> : Base {};
+
+template <typename Derived, typename Base, typename T, typename... Ts>
+struct poly_visit_all<Derived, Base, T, Ts...>
+    : poly_visit_all<Derived, Base, Ts...> {
+  int visit(const T& x) const override {
+    return static_cast<const Derived&>(*this).f(x);
+  }
+};
+
+template <typename F, typename P>
+struct poly_function_visitor;
+
+template <typename F, typename... Ts>
+struct poly_function_visitor<F, poly<Ts...>>
+    : poly_visit_all<poly_function_visitor<F, poly<Ts...>>,
+                     typename poly<Ts...>::visitor, Ts...> {
+  F f;
+
+  explicit poly_function_visitor(F f) : f(std::move(f)) {}
+};
+
+template <typename P, typename F>
+int poly_visit(const P& p, F f) {
+  return p.accept(poly_function_visitor<F, P>(std::move(f)));
+}
+
+struct toby_impl {
+  static constexpr const char* name = "toby";
+  template <typename... Ts>
+  using variant = toby::variant<Ts...>;
+
+  template <typename V, typename F>
+  static int visit(const V& v, F f) {
+    return v.template visit<int>(f);
+  }
+  template <typename V, typename F>
+  static int visit2(const V& a, const V& b, F f) {
+    return toby::make_multivisitor<int>(f)(a, b);
+  }
+};
+
+struct std_impl {
+  static constexpr const char* name = "std";
+  template <typename... Ts>
+  using variant = std::variant<Ts...>;
+
+  template <typename V, typename F>
+  static int visit(const V& v, F f) {
+    return std::visit(f, v);
+  }
+  template <typename V, typename F>
+  static int visit2(const V& a, const V& b, F f) {
+    return std::visit(f, a, b);
+  }
+};
+
+// The hand-rolled union only knows about std::string and std::vector<int>.
+struct svu_impl {
+  static constexpr const char* name = "svu";
+  template <typename... Ts>
+  using variant = svu;
+
+  template <typename V, typename F>
+  static int visit(const V& v, F f) {
+    return v.template visit<int>(f);
+  }
+  template <typename V, typename F>
+  static int visit2(const V& a, const V& b, F f) {
+    return toby::make_multivisitor<int>(f)(a, b);
+  }
+};
+
+struct virtual_impl {
+  static constexpr const char* name = "virtual";
+  template <typename... Ts>
+  using variant = poly<Ts...>;
+
+  template <typename V, typename F>
+  static int visit(const V& v, F f) {
+    return poly_visit(v, f);
+  }
+  template <typename V, typename F>
+  static int visit2(const V& a, const V& b, F f) {
+    return poly_visit(a, [&](const auto& x) {
+      return poly_visit(b, [&](const auto& y) { return f(x, y); });
+    });
+  }
+};
+
+constexpr std::size_t input_size = 1 << 14;
+
+template <typename V, typename T>
+V make_value(int value) {
+  return V(sample(type_tag<T>(), value));
+}
+
+// Makes input_size variants holding randomly chosen alternatives, each shifted
+// by offset alternatives from the one chosen by seed.
+template <typename V, typename... Ts>
+std::vector<V> make_input(unsigned seed, std::size_t offset) {
+  using factory = V (*)(int);
+  static const factory factories[] = {&make_value<V, Ts>...};
+  constexpr std::size_t n = sizeof...(Ts);
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<std::size_t> pick(0, n - 1);
+  std::vector<V> input;
+  input.reserve(input_size);
+  for (std::size_t i = 0; i < input_size; ++i) {
+    input.push_back(factories[(pick(rng) + offset) % n](static_cast<int>(i)));
+  }
+  return input;
+}
+
+template <typename Impl, typename T0, typename... Ts>
+void run_impl(bench::suite& s, const std::string& label) {
+  using V = typename Impl::template variant<T0, Ts...>;
+  auto name = [&](const char* op) {
+    return std::string(op) + "/" + Impl::name + "/" + label;
+  };
+  const auto src = make_input<V, T0, Ts...>(42, 0);
+  const auto other = make_input<V, T0, Ts...>(42, 1);
+
+  std::vector<T0> values;
+  for (std::size_t i = 0; i < input_size; ++i) {
+    values.push_back(sample(type_tag<T0>(), static_cast<int>(i)));
+  }
+  s.run(name("construct"),
+        [&] {
+          for (const auto& x : values) {
+            V v(x);
+            bench::do_not_optimize(v);
+          }
+        },
+        input_size);
+
+  s.run(name("copy"),
+        [&] {
+          for (const auto& x : src) {
+            V v(x);
+            bench::do_not_optimize(v);
+          }
+        },
+        input_size);
+
+  // Relocates every element between two buffers, as vector growth does.
+  if (s.selected(name("move"))) {
+    using slot = std::aligned_storage_t<sizeof(V), alignof(V)>;
+    std::unique_ptr<slot[]> a(new slot[input_size]);
+    std::unique_ptr<slot[]> b(new slot[input_size]);
+    for (std::size_t i = 0; i < input_size; ++i) {
+      new (&a[i]) V(src[i]);
+    }
+    s.run(name("move"),
+          [&] {
+            for (std::size_t i = 0; i < input_size; ++i) {
+              V& from = reinterpret_cast<V&>(a[i]);
+              new (&b[i]) V(std::move(from));
+              from.~V();
+            }
+            std::swap(a, b);
+            bench::do_not_optimize(a);
+          },
+          input_size);
+    for (std::size_t i = 0; i < input_size; ++i) {
+      reinterpret_cast<V&>(a[i]).~V();
+    }
+  }
+
+  // The same, through toby::uninitialized_relocate, which copies the whole
+  // buffer at once when V is trivially relocatable.
+  if (s.selected(name("relocate"))) {
+    using slot = std::aligned_storage_t<sizeof(V), alignof(V)>;
+    std::unique_ptr<slot[]> a(new slot[input_size]);
+    std::unique_ptr<slot[]> b(new slot[input_size]);
+    for (std::size_t i = 0; i < input_size; ++i) {
+      new (&a[i]) V(src[i]);
+    }
+    s.run(name("relocate"),
+          [&] {
+            auto first = reinterpret_cast<V*>(a.get());
+            toby::uninitialized_relocate(first, first + input_size,
+                                         reinterpret_cast<V*>(b.get()));
+            std::swap(a, b);
+            bench::do_not_optimize(a);
+          },
+          input_size);
+    for (std::size_t i = 0; i < input_size; ++i) {
+      reinterpret_cast<V&>(a[i]).~V();
+    }
+  }
+
+  auto same = src;
+  s.run(name("assign_same"),
+        [&] {
+          for (std::size_t i = 0; i < input_size; ++i) {
+            same[i] = src[i];
+          }
+          bench::do_not_optimize(same);
+        },
+        input_size);
+
+  auto cross = src;
+  s.run(name("assign_cross"),
+        [&] {
+          for (std::size_t i = 0; i < input_size; ++i) {
+            cross[i] = other[i];
+            cross[i] = src[i];
+          }
+          bench::do_not_optimize(cross);
+        },
+        2 * input_size);
+
+  s.run(name("visit"),
+        [&] {
+          int sum = 0;
+          for (const auto& v : src) {
+            sum += Impl::visit(v, value_visitor{});
+          }
+          bench::do_not_optimize(sum);
+        },
+        input_size);
+
+  s.run(name("multivisit"),
+        [&] {
+          int sum = 0;
+          for (std::size_t i = 0; i < input_size; ++i) {
+            sum += Impl::visit2(src[i], other[i], pair_visitor{});
+          }
+          bench::do_not_optimize(sum);
+        },
+        input_size);
+}
+
+template <typename Is, std::size_t Size>
+struct payloads;
+
+template <std::size_t... I, std::size_t Size>
+struct payloads<std::index_sequence<I...>, Size> {
+  template <typename Impl>
+  static void run(bench::suite& s) {
+    run_impl<Impl, payload<I, Size>...>(
+        s, std::to_string(sizeof...(I)) + "/" + std::to_string(Size) + "B");
+  }
+};
+
+template <std::size_t N, std::size_t Size>
+void run_payloads(bench::suite& s) {
+  using p = payloads<std::make_index_sequence<N>, Size>;
+  p::template run<toby_impl>(s);
+  p::template run<std_impl>(s);
+  p::template run<virtual_impl>(s);
+}
+
+// Wraps V with a move constructor that is not noexcept, which is how every
+// toby::variant behaved before its special members propagated noexcept.
+template <typename V>
+struct throwing_move : V {
+  using V::V;
+  throwing_move(const throwing_move&) = default;
+  throwing_move(throwing_move&& other) noexcept(false) : V(std::move(other)) {}
+  throwing_move& operator=(const throwing_move&) = default;
+  throwing_move& operator=(throwing_move&&) = default;
+};
+
+// Grows a vector one push_back at a time; the vector moves its elements on
+// reallocation only if their move constructor is noexcept, and copies them
+// otherwise.
+template <typename V>
+void run_growth(bench::suite& s, const std::string& label) {
+  std::vector<std::string> values;
+  for (std::size_t i = 0; i < 1024; ++i) {
+    values.push_back(sample(type_tag<std::string>(), static_cast<int>(i)));
+  }
+  s.run("push_back/toby/" + label,
+        [&] {
+          std::vector<V> v;
+          for (const auto& x : values) {
+            v.push_back(V(x));
+          }
+          bench::do_not_optimize(v);
+        },
+        values.size());
+}
+
+int main(int argc, char** argv) {
+  bench::suite s(std::chrono::milliseconds(100));
+  if (argc > 1) {
+    s.set_filter(argv[1]);
+  }
+
+  run_payloads<2, 8>(s);
+  run_payloads<8, 8>(s);
+  run_payloads<16, 8>(s);
+  run_payloads<2, 64>(s);
+  run_payloads<8, 64>(s);
+  run_payloads<16, 64>(s);
+
+  run_impl<toby_impl, std::string, std::vector<int>>(s, "2/heap");
+  run_impl<std_impl, std::string, std::vector<int>>(s, "2/heap");
+  run_impl<svu_impl, std::string, std::vector<int>>(s, "2/heap");
+  run_impl<virtual_impl, std::string, std::vector<int>>(s, "2/heap");
+
+  using string_variant = toby::variant<std::string, std::vector<int>>;
+  run_growth<string_variant>(s, "2/heap/noexcept");
+  run_growth<throwing_move<string_variant>>(s, "2/heap/throwing");
+
+  s.write_json(std::cout);
+}
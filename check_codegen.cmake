@@ -0,0 +1,39 @@
+# Checks that the visitors in codegen_visit.cpp were inlined into the switch
+# generated by variant_switch: none of the codegen_visit_* functions may call
+# or tail-call into the visitor or any of the dispatch helpers.
+#
+# Usage: cmake -DASM=<file.s> -P check_codegen.cmake
+
+if(NOT ASM)
+  message(FATAL_ERROR "ASM not set")
+endif()
+
+file(STRINGS "${ASM}" lines)
+
+set(function "")
+set(found "")
+set(failures "")
+foreach(line IN LISTS lines)
+  if(line MATCHES "^_?(codegen_visit_[a-z]+):")
+    set(function "${CMAKE_MATCH_1}")
+    list(APPEND found "${function}")
+  elseif(line MATCHES "\\.cfi_endproc|^[ \t]*\\.size[ \t]")
+    set(function "")
+  elseif(function AND line MATCHES "^[ \t]*(call|jmp|bl|b)[a-z]*[ \t]+[^*.]")
+    if(line MATCHES "codegen_probe|variant_case|variant_switch|variant_visit|Ul")
+      list(APPEND failures "${function}: ${line}")
+    endif()
+  endif()
+endforeach()
+
+foreach(expected codegen_visit_const codegen_visit_rvalue codegen_visit_lambda)
+  list(FIND found ${expected} index)
+  if(index EQUAL -1)
+    message(FATAL_ERROR "${expected} not found in ${ASM}")
+  endif()
+endforeach()
+
+if(failures)
+  string(REPLACE ";" "\n  " failures "${failures}")
+  message(FATAL_ERROR "visitor was not inlined:\n  ${failures}")
+endif()
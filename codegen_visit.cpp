@@ -0,0 +1,26 @@
+// Compiled to assembly by the codegen_visit test; see check_codegen.cmake.
+#include "variant.hpp"
+
+using toby::variant;
+
+struct codegen_probe {
+  int operator()(int x) const { return x + 1; }
+  int operator()(long x) const { return static_cast<int>(x) * 3; }
+  int operator()(short x) const { return x - 7; }
+  int operator()(char x) const { return x ^ 0x55; }
+  int operator()(float x) const { return static_cast<int>(x); }
+};
+
+using small_variant = variant<int, long, short, char, float>;
+
+extern "C" int codegen_visit_const(const small_variant& v) {
+  return v.visit<int>(codegen_probe{});
+}
+
+extern "C" int codegen_visit_rvalue(small_variant&& v) {
+  return std::move(v).visit<int>(codegen_probe{});
+}
+
+extern "C" int codegen_visit_lambda(const small_variant& v, int bias) {
+  return v.visit<int>([bias](auto x) { return static_cast<int>(x) + bias; });
+}
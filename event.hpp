@@ -1,3 +1,6 @@
+#ifndef INCLUDED_EVENT_H
+#define INCLUDED_EVENT_H
+
 #include <iostream>
 #include <string>
 
@@ -13,12 +16,20 @@ struct heading_changed {
   float heading;
 };
 
-std::ostream& operator<<(std::ostream& os, const start_turning& e) {
+inline std::ostream& operator<<(std::ostream& os, const turn_on&) {
+  return os << "turn_on{}";
+}
+inline std::ostream& operator<<(std::ostream& os, const turn_off&) {
+  return os << "turn_off{}";
+}
+inline std::ostream& operator<<(std::ostream& os, const start_turning& e) {
   return os << "start_turning{" << e.target << "}";
 }
-std::ostream& operator<<(std::ostream& os, const reset& e) {
+inline std::ostream& operator<<(std::ostream& os, const reset& e) {
   return os << "reset{" << e.reason << "}";
 }
-std::ostream& operator<<(std::ostream& os, const heading_changed& e) {
-  return os << "heading_changed" << e.heading << "}";
+inline std::ostream& operator<<(std::ostream& os, const heading_changed& e) {
+  return os << "heading_changed{" << e.heading << "}";
 }
+
+#endif
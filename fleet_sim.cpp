@@ -0,0 +1,153 @@
+#include "alloc_counter.hpp"
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::size_t robots = 1000000;
+  std::size_t transitions = 20000000;
+  std::size_t batch = 10000;
+  std::string mix = "uniform";
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--robots", value)) {
+      opts.robots = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--transitions", value)) {
+      opts.transitions = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--batch", value)) {
+      opts.batch = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--mix", value)) {
+      opts.mix = value;
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.robots == 0 || opts.batch == 0) {
+    throw std::invalid_argument("--robots and --batch must be positive");
+  }
+  if (opts.mix != "heading" && opts.mix != "reset" && opts.mix != "uniform") {
+    throw std::invalid_argument("--mix must be heading, reset or uniform");
+  }
+  return opts;
+}
+
+// Relative weights of turn_on, turn_off, start_turning, reset and
+// heading_changed in each event mix.
+std::discrete_distribution<int> event_weights(const std::string& mix) {
+  if (mix == "heading") {
+    return bench::heading_mix();
+  } else if (mix == "reset") {
+    return {10, 10, 10, 60, 10};
+  }
+  return {1, 1, 1, 1, 1};
+}
+
+std::vector<state> make_fleet(std::size_t n) {
+  std::mt19937 rng(2);
+  std::uniform_int_distribution<int> pick(0, 2);
+  std::vector<state> fleet;
+  fleet.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    switch (pick(rng)) {
+      case 0: fleet.push_back(off{}); break;
+      case 1: fleet.push_back(idle{}); break;
+      default: fleet.push_back(turning{180}); break;
+    }
+  }
+  return fleet;
+}
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  auto n = static_cast<std::size_t>(p * (values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + n, values.end());
+  return values[n];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: fleet_sim [--robots=N] [--transitions=N] "
+                 "[--batch=N] [--mix=heading|reset|uniform]\n";
+    return 2;
+  }
+
+  // A prime number of events so that robots see different sequences on each
+  // pass over the fleet.
+  const auto events = bench::make_events(
+      65521, event_weights(opts.mix), "watchdog expired on drive controller");
+  auto fleet = make_fleet(opts.robots);
+
+  using clock = std::chrono::steady_clock;
+  std::vector<double> batch_ns;
+  batch_ns.reserve(opts.transitions / opts.batch + 1);
+  std::size_t robot = 0;
+  std::size_t next_event = 0;
+  std::size_t done = 0;
+
+  auto allocations_before = alloc_counter::allocations();
+  auto start = clock::now();
+  while (done < opts.transitions) {
+    auto n = std::min(opts.batch, opts.transitions - done);
+    auto batch_start = clock::now();
+    for (std::size_t i = 0; i < n; ++i) {
+      fleet[robot] = transition(fleet[robot], events[next_event]);
+      if (++robot == fleet.size()) robot = 0;
+      if (++next_event == events.size()) next_event = 0;
+    }
+    auto batch_end = clock::now();
+    batch_ns.push_back(
+        std::chrono::duration<double, std::nano>(batch_end - batch_start)
+            .count());
+    done += n;
+  }
+  auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+  auto allocations = alloc_counter::allocations() - allocations_before;
+  auto per_second = elapsed > 0 ? done / elapsed : 0;
+  auto per_transition = done ? static_cast<double>(allocations) / done : 0;
+
+  std::size_t counts[3] = {};
+  for (const auto& s : fleet) {
+    ++counts[s.tag];
+  }
+
+  std::cout << "{\n"
+            << "  \"mix\": \"" << opts.mix << "\",\n"
+            << "  \"robots\": " << opts.robots << ",\n"
+            << "  \"transitions\": " << done << ",\n"
+            << "  \"batch\": " << opts.batch << ",\n"
+            << "  \"seconds\": " << elapsed << ",\n"
+            << "  \"transitions_per_second\": " << per_second << ",\n"
+            << "  \"batch_p50_ns\": " << percentile(batch_ns, 0.5) << ",\n"
+            << "  \"batch_p99_ns\": " << percentile(batch_ns, 0.99) << ",\n"
+            << "  \"bytes_per_robot\": "
+            << static_cast<double>(fleet.capacity() * sizeof(state)) /
+                   fleet.size()
+            << ",\n"
+            << "  \"allocations_per_transition\": " << per_transition << ",\n"
+            << "  \"final_states\": {\"off\": " << counts[0]
+            << ", \"idle\": " << counts[1] << ", \"turning\": " << counts[2]
+            << "}\n"
+            << "}\n";
+}
@@ -0,0 +1,218 @@
+#ifndef INCLUDED_TOBY_CHARCONV_H
+#define INCLUDED_TOBY_CHARCONV_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <locale.h>
+#include <stdlib.h>
+#if defined(__APPLE__) || defined(__FreeBSD__)
+#include <xlocale.h>
+#endif
+
+namespace toby {
+
+// Like C++17's std::from_chars: parses a number at the start of
+// [first, last) without skipping whitespace, allocating, or consulting the
+// locale.  On success ptr points past the number and ec is std::errc();
+// otherwise ec is invalid_argument or result_out_of_range and value is
+// unchanged.
+struct from_chars_result {
+  const char* ptr;
+  std::errc ec;
+};
+
+template <typename T>
+std::enable_if_t<std::is_integral<T>::value, from_chars_result> from_chars(
+    const char* first, const char* last, T& value) {
+  using U = std::make_unsigned_t<T>;
+  const char* p = first;
+  bool negative = false;
+  if (std::is_signed<T>::value && p != last && *p == '-') {
+    negative = true;
+    ++p;
+  }
+  U limit = negative ? U(U(std::numeric_limits<T>::max()) + 1)
+                     : U(std::numeric_limits<T>::max());
+  U result = 0;
+  bool overflow = false;
+  const char* digits = p;
+  for (; p != last && *p >= '0' && *p <= '9'; ++p) {
+    U d = static_cast<U>(*p - '0');
+    if (result > (limit - d) / 10) {
+      overflow = true;
+    }
+    result = static_cast<U>(result * 10 + d);
+  }
+  if (p == digits) {
+    return {first, std::errc::invalid_argument};
+  }
+  if (overflow) {
+    return {p, std::errc::result_out_of_range};
+  }
+  value = negative ? static_cast<T>(0 - result) : static_cast<T>(result);
+  return {p, std::errc()};
+}
+
+namespace detail {
+// strtod and strtof read a decimal point that depends on the global locale;
+// these use the C locale instead.
+#if defined(_WIN32)
+inline _locale_t c_locale() {
+  static const _locale_t locale = _create_locale(LC_ALL, "C");
+  return locale;
+}
+inline void c_strto(const char* s, double& value) {
+  value = _strtod_l(s, nullptr, c_locale());
+}
+inline void c_strto(const char* s, float& value) {
+  value = _strtof_l(s, nullptr, c_locale());
+}
+#else
+inline locale_t c_locale() {
+  static const locale_t locale = newlocale(LC_ALL_MASK, "C", locale_t());
+  return locale;
+}
+inline void c_strto(const char* s, double& value) {
+  value = strtod_l(s, nullptr, c_locale());
+}
+inline void c_strto(const char* s, float& value) {
+  value = strtof_l(s, nullptr, c_locale());
+}
+#endif
+
+// The powers of ten that are exact in T, and how many significant decimal
+// digits a mantissa that is exact in T may have.
+template <typename T>
+struct exact_powers;
+
+template <>
+struct exact_powers<double> {
+  static constexpr int digits = 15;
+  static constexpr int max_exponent = 22;
+  static double get(long long exponent) {
+    static constexpr double powers[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    return powers[exponent];
+  }
+};
+
+template <>
+struct exact_powers<float> {
+  static constexpr int digits = 7;
+  static constexpr int max_exponent = 10;
+  static float get(long long exponent) {
+    static constexpr float powers[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                       1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+    return powers[exponent];
+  }
+};
+
+// Parses a decimal floating point number straight into T, so that a float
+// is rounded once rather than via double.  When the mantissa and the power
+// of ten are both exactly representable, one multiplication or division
+// gives the correctly rounded result; anything else falls back to strtod or
+// strtof in the C locale.
+template <typename T>
+from_chars_result parse_float(const char* first, const char* last, T& value) {
+  const char* p = first;
+  bool negative = p != last && *p == '-';
+  if (negative) {
+    ++p;
+  }
+  std::uint64_t mantissa = 0;
+  int significant = 0;
+  long long exponent = 0;
+  bool any = false;
+  for (; p != last && *p >= '0' && *p <= '9'; ++p) {
+    any = true;
+    if (significant < 19) {
+      mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+      significant += mantissa != 0;
+    } else {
+      ++exponent;
+    }
+  }
+  if (p != last && *p == '.') {
+    for (++p; p != last && *p >= '0' && *p <= '9'; ++p) {
+      any = true;
+      if (significant < 19) {
+        mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+        significant += mantissa != 0;
+        --exponent;
+      }
+    }
+  }
+  if (!any) {
+    return {first, std::errc::invalid_argument};
+  }
+  if (p != last && (*p == 'e' || *p == 'E')) {
+    const char* e = p + 1;
+    bool negative_exponent = e != last && *e == '-';
+    if (e != last && (*e == '-' || *e == '+')) {
+      ++e;
+    }
+    // Exponents beyond any T saturate; strtod then gives zero or infinity.
+    long long exp = 0;
+    const char* digits = e;
+    for (; e != last && *e >= '0' && *e <= '9'; ++e) {
+      exp = std::min(exp * 10 + (*e - '0'), 100000LL);
+    }
+    if (e != digits) {
+      exponent += negative_exponent ? -exp : exp;
+      p = e;
+    }
+  }
+
+  using powers = exact_powers<T>;
+  if (significant <= powers::digits && exponent >= -powers::max_exponent &&
+      exponent <= powers::max_exponent) {
+    T d = static_cast<T>(mantissa);
+    d = exponent < 0 ? d / powers::get(-exponent) : d * powers::get(exponent);
+    value = negative ? -d : d;
+    return {p, std::errc()};
+  }
+
+  char buffer[64];
+  std::string long_number;
+  auto size = static_cast<std::size_t>(p - first);
+  const char* s = buffer;
+  if (size < sizeof(buffer)) {
+    std::memcpy(buffer, first, size);
+    buffer[size] = '\0';
+  } else {
+    long_number.assign(first, size);
+    s = long_number.c_str();
+  }
+  T d;
+  c_strto(s, d);
+  if (d == std::numeric_limits<T>::infinity() ||
+      d == -std::numeric_limits<T>::infinity()) {
+    return {p, std::errc::result_out_of_range};
+  }
+  value = d;
+  return {p, std::errc()};
+}
+}  // namespace detail
+
+inline from_chars_result from_chars(const char* first, const char* last,
+                                    double& value) {
+  return detail::parse_float(first, last, value);
+}
+
+inline from_chars_result from_chars(const char* first, const char* last,
+                                    float& value) {
+  return detail::parse_float(first, last, value);
+}
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef INCLUDED_TOBY_COALESCING_QUEUE_H
+#define INCLUDED_TOBY_COALESCING_QUEUE_H
+
+#include "variant.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+enum class coalesce_policy {
+  // Every event is queued.
+  keep_all,
+  // An event replaces one of the same alternative at the back of the queue.
+  keep_latest,
+  // An event equal to the one at the back of the queue is dropped.
+  drop_duplicates
+};
+
+// The policy of each alternative of the events in a coalescing_queue.
+// Specialise it for alternatives whose repeats can be merged.
+template <typename T, typename Enable = void>
+struct coalescing
+    : std::integral_constant<coalesce_policy, coalesce_policy::keep_all> {};
+
+namespace detail {
+template <typename T>
+bool same_event(const T&, const T&, std::true_type) {
+  return true;
+}
+template <typename T>
+bool same_event(const T& a, const T& b, std::false_type) {
+  return a == b;
+}
+}  // namespace detail
+
+template <typename Event>
+class coalescing_queue;
+
+// A FIFO queue of variants that merges an event with the one at the back of
+// the queue when the policy of its alternative allows, so that a burst of
+// updates that only matter for their latest value takes a single slot and a
+// single transition.  Only the back is considered, so merging never moves
+// an event past another one.
+template <typename... Ts>
+class coalescing_queue<variant<Ts...>> {
+ private:
+  using event = variant<Ts...>;
+
+  std::deque<event> m_events;
+  std::size_t m_merged = 0;
+  std::size_t m_peak = 0;
+
+  template <typename T>
+  T* back_as() {
+    if (m_events.empty() ||
+        m_events.back().tag != detail::index_of<T, Ts...>::value) {
+      return nullptr;
+    }
+    return reinterpret_cast<T*>(&m_events.back().storage);
+  }
+
+  template <typename T>
+  bool coalesce(T&&, std::integral_constant<coalesce_policy,
+                                            coalesce_policy::keep_all>) {
+    return false;
+  }
+  template <typename T>
+  bool coalesce(T&& e, std::integral_constant<coalesce_policy,
+                                              coalesce_policy::keep_latest>) {
+    if (auto back = back_as<std::decay_t<T>>()) {
+      *back = std::forward<T>(e);
+      return true;
+    }
+    return false;
+  }
+  template <typename T>
+  bool coalesce(
+      T&& e, std::integral_constant<coalesce_policy,
+                                    coalesce_policy::drop_duplicates>) {
+    using U = std::decay_t<T>;
+    auto back = back_as<U>();
+    return back && detail::same_event(*back, e, std::is_empty<U>());
+  }
+
+ public:
+  // Queues e, an alternative or an event, unless it merges with the event
+  // at the back.  Returns whether it was queued.
+  template <typename T, typename = std::enable_if_t<
+                            detail::is_one_of<std::decay_t<T>, Ts...>::value>>
+  bool push(T&& e) {
+    using U = std::decay_t<T>;
+    if (coalesce(std::forward<T>(e), coalescing<U>())) {
+      ++m_merged;
+      return false;
+    }
+    m_events.emplace_back(std::forward<T>(e));
+    m_peak = std::max(m_peak, m_events.size());
+    return true;
+  }
+  bool push(const event& e) {
+    return e.template visit<bool>(
+        [this](const auto& alternative) { return this->push(alternative); });
+  }
+  bool push(event&& e) {
+    return std::move(e).template visit<bool>([this](auto&& alternative) {
+      return this->push(std::move(alternative));
+    });
+  }
+
+  bool empty() const noexcept { return m_events.empty(); }
+  std::size_t size() const noexcept { return m_events.size(); }
+  const event& front() const { return m_events.front(); }
+  void pop() { m_events.pop_front(); }
+
+  // Passes each queued event to f, oldest first, and empties the queue.
+  // Returns the number of events passed.
+  template <typename F>
+  std::size_t consume(F&& f) {
+    auto n = m_events.size();
+    for (auto& e : m_events) {
+      f(std::move(e));
+    }
+    m_events.clear();
+    return n;
+  }
+
+  // Number of events merged away since the queue was made.
+  std::size_t merged() const noexcept { return m_merged; }
+  // Largest number of events the queue has held at once.
+  std::size_t peak() const noexcept { return m_peak; }
+};
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef INCLUDED_TOBY_COMPRESSED_STREAM_H
+#define INCLUDED_TOBY_COMPRESSED_STREAM_H
+
+#include "serialize.hpp"
+#include "variant.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+namespace detail {
+inline void write_varint(writer& w, std::uint64_t value) {
+  unsigned char bytes[10];
+  std::size_t n = 0;
+  while (value >= 0x80) {
+    bytes[n++] = static_cast<unsigned char>(value | 0x80);
+    value >>= 7;
+  }
+  bytes[n++] = static_cast<unsigned char>(value);
+  w.write(bytes, n);
+}
+
+inline std::uint64_t read_varint(reader& r) {
+  std::uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    auto byte = static_cast<unsigned char>(*r.read(1));
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return value;
+    }
+  }
+  throw deserialize_error("varint too long");
+}
+}  // namespace detail
+
+// Encodes successive values of a T, each relative to the one before.  By
+// default a value is written with its serializer; integers are written as
+// the zigzag varint of their difference from the previous value, and
+// floating point numbers as the bytes of their XOR with the previous value
+// that are not zero.  Specialise this for structs to encode their fields
+// this way, e.g. by deriving from member_codec.
+template <typename T, typename Enable = void>
+struct delta_codec {
+  void encode(writer& w, const T& value) { serializer<T>::write(w, value); }
+  T decode(reader& r) { return serializer<T>::read(r); }
+};
+
+template <typename T>
+struct delta_codec<T, std::enable_if_t<std::is_integral<T>::value &&
+                                       !std::is_same<T, bool>::value>> {
+  using bits = std::make_unsigned_t<T>;
+  bits previous = 0;
+
+  void encode(writer& w, T value) {
+    auto delta = static_cast<bits>(static_cast<bits>(value) - previous);
+    previous = static_cast<bits>(value);
+    auto d = static_cast<std::uint64_t>(
+        static_cast<std::int64_t>(static_cast<std::make_signed_t<T>>(delta)));
+    detail::write_varint(w, (d << 1) ^ (0 - (d >> 63)));
+  }
+  T decode(reader& r) {
+    auto z = detail::read_varint(r);
+    auto delta = static_cast<bits>((z >> 1) ^ (0 - (z & 1)));
+    previous = static_cast<bits>(previous + delta);
+    return static_cast<T>(previous);
+  }
+};
+
+// Slowly changing floating point values share their sign, exponent and top
+// mantissa bits with the previous value, so their XOR has leading zero
+// bytes, and round values have trailing ones.  A header byte holds the count
+// of trailing zero bytes in its low nibble and of remaining bytes in its
+// high nibble; an unchanged value takes just the header.
+template <typename T>
+struct delta_codec<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+  using bits = typename detail::uint_of_size<sizeof(T)>::type;
+  bits previous = 0;
+
+  void encode(writer& w, T value) {
+    bits u;
+    std::memcpy(&u, &value, sizeof(u));
+    bits x = u ^ previous;
+    previous = u;
+    unsigned trailing = 0;
+    while (trailing < sizeof(bits) && ((x >> (8 * trailing)) & 0xff) == 0) {
+      ++trailing;
+    }
+    unsigned length = 0;
+    for (unsigned i = trailing; i < sizeof(bits); ++i) {
+      if ((x >> (8 * i)) & 0xff) {
+        length = i + 1 - trailing;
+      }
+    }
+    unsigned char bytes[1 + sizeof(bits)];
+    bytes[0] = static_cast<unsigned char>(length << 4 | trailing);
+    for (unsigned i = 0; i < length; ++i) {
+      bytes[1 + i] = static_cast<unsigned char>(x >> (8 * (trailing + i)));
+    }
+    w.write(bytes, 1 + length);
+  }
+  T decode(reader& r) {
+    auto header = static_cast<unsigned char>(*r.read(1));
+    unsigned trailing = header & 0xf;
+    unsigned length = header >> 4;
+    if (trailing + length > sizeof(bits)) {
+      throw deserialize_error("corrupt floating point delta");
+    }
+    auto bytes = reinterpret_cast<const unsigned char*>(r.read(length));
+    bits x = 0;
+    for (unsigned i = 0; i < length; ++i) {
+      x = static_cast<bits>(x | static_cast<bits>(bytes[i])
+                                    << (8 * (trailing + i)));
+    }
+    previous ^= x;
+    T value;
+    std::memcpy(&value, &previous, sizeof(value));
+    return value;
+  }
+};
+
+// A delta_codec for a T through its single data member.
+template <typename T, typename M, M T::*Member>
+struct member_codec {
+  delta_codec<M> codec;
+
+  void encode(writer& w, const T& value) { codec.encode(w, value.*Member); }
+  T decode(reader& r) {
+    T value{};
+    value.*Member = codec.decode(r);
+    return value;
+  }
+};
+
+template <typename V>
+class compressed_encoder;
+
+// Compresses a sequence of variant<Ts...>.  Consecutive values with the same
+// tag form a run, written as the varint tag and run length followed by the
+// payloads, each delta encoded against the previous value of the same
+// alternative.  Call flush() to write the last run; the destructor also
+// does, so out must outlive the encoder, but it cannot report a failure to
+// write.
+template <typename... Ts>
+class compressed_encoder<variant<Ts...>> {
+ private:
+  writer m_out;
+  std::tuple<delta_codec<Ts>...> m_codecs;
+  std::string m_run;
+  std::size_t m_run_tag = 0;
+  std::size_t m_run_length = 0;
+
+ public:
+  explicit compressed_encoder(std::string& out) : m_out(out) {}
+  compressed_encoder(const compressed_encoder&) = delete;
+  compressed_encoder& operator=(const compressed_encoder&) = delete;
+  ~compressed_encoder() {
+    try {
+      flush();
+    } catch (...) {
+      // Throwing from a destructor would terminate; flush() reports it.
+    }
+  }
+
+  template <typename T, typename = std::enable_if_t<
+                            detail::is_one_of<T, Ts...>::value>>
+  void push(const T& value) {
+    constexpr auto tag = detail::index_of<T, Ts...>::value;
+    if (m_run_length != 0 && m_run_tag != tag) {
+      flush();
+    }
+    m_run_tag = tag;
+    ++m_run_length;
+    writer w(m_run);
+    std::get<tag>(m_codecs).encode(w, value);
+  }
+  void push(const variant<Ts...>& v) {
+    v.template visit<void>([this](const auto& value) { this->push(value); });
+  }
+
+  void flush() {
+    if (m_run_length != 0) {
+      detail::write_varint(m_out, m_run_tag);
+      detail::write_varint(m_out, m_run_length);
+      m_out.write(m_run.data(), m_run.size());
+      m_run.clear();
+      m_run_length = 0;
+    }
+  }
+};
+
+template <typename V>
+class compressed_decoder;
+
+// Decodes the output of compressed_encoder one value at a time, straight
+// from the compressed buffer.
+template <typename... Ts>
+class compressed_decoder<variant<Ts...>> {
+ private:
+  reader m_in;
+  std::tuple<delta_codec<Ts>...> m_codecs;
+  std::size_t m_run_tag = 0;
+  std::uint64_t m_run_length = 0;
+
+  template <typename R, std::size_t I, typename F>
+  static R decode_one(compressed_decoder& d, F& f) {
+    return f(std::get<I>(d.m_codecs).decode(d.m_in));
+  }
+  template <typename R, typename F, std::size_t... Is>
+  R dispatch(F& f, std::index_sequence<Is...>) {
+    using fn = R (*)(compressed_decoder&, F&);
+    static constexpr fn decoders[] = {&decode_one<R, Is, F>...};
+    return decoders[m_run_tag](*this, f);
+  }
+
+ public:
+  compressed_decoder(const char* data, std::size_t size) : m_in(data, size) {}
+
+  bool empty() const noexcept { return m_run_length == 0 && m_in.empty(); }
+
+  // Decodes the next value and returns f applied to its alternative.  Must
+  // not be called when empty().  Throws deserialize_error if the data is
+  // corrupt.
+  template <typename R, typename F>
+  R visit_next(F&& f) {
+    if (m_run_length == 0) {
+      auto tag = detail::read_varint(m_in);
+      auto length = detail::read_varint(m_in);
+      if (tag >= sizeof...(Ts)) {
+        throw deserialize_error("invalid variant tag " + std::to_string(tag));
+      }
+      if (length == 0) {
+        throw deserialize_error("empty run in compressed stream");
+      }
+      m_run_tag = static_cast<std::size_t>(tag);
+      m_run_length = length;
+    }
+    --m_run_length;
+    return dispatch<R>(f, std::index_sequence_for<Ts...>());
+  }
+  template <typename R, typename... Fs>
+  R visit_next(Fs&&... fs) {
+    return visit_next<R>(overload_set<Fs...>(std::forward<Fs>(fs)...));
+  }
+
+  variant<Ts...> next() {
+    return visit_next<variant<Ts...>>(
+        [](auto&& value) { return variant<Ts...>(std::move(value)); });
+  }
+};
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef INCLUDED_TOBY_DISPATCH_MANY_H
+#define INCLUDED_TOBY_DISPATCH_MANY_H
+
+#include "multivisitor.hpp"
+#include "span.hpp"
+#include "variant.hpp"
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+// Sets s to visitor(s, e) for each e in events, in order.  The alternative
+// of s is resolved once for each run of events that leaves it the same, and
+// within a run only the events are visited and the new payload is
+// move-assigned over the old one.
+template <typename F, typename... Ss, typename E>
+void dispatch_many(multivisitor<variant<Ss...>, F>& visitor,
+                   variant<Ss...>& s, span<const E> events) {
+  std::size_t i = 0;
+  while (i != events.size()) {
+    visitor.bind_first(s, [&](const auto& bound) {
+      using T = typename std::decay_t<decltype(bound)>::first_type;
+      const auto tag = s.tag;
+      while (i != events.size()) {
+        variant<Ss...> next = bound(events[i++]);
+        if (next.tag != tag) {
+          s = std::move(next);
+          return;
+        }
+        *reinterpret_cast<T*>(&s.storage) =
+            std::move(*reinterpret_cast<T*>(&next.storage));
+      }
+    });
+  }
+}
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef INCLUDED_TOBY_EVENT_LOG_H
+#define INCLUDED_TOBY_EVENT_LOG_H
+
+#include "mapped_file.hpp"
+#include "serialize.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace toby {
+namespace detail {
+
+// Log files are named <prefix>-<sequence number>.<suffix>, where the sequence
+// number is that of the first event in a segment, or the number of events a
+// snapshot has seen.
+inline std::string log_file_name(const std::string& dir, const char* prefix,
+                                 std::uint64_t seq, const char* suffix) {
+  char name[64];
+  std::snprintf(name, sizeof(name), "%s-%020" PRIu64 ".%s", prefix, seq,
+                suffix);
+  return dir + "/" + name;
+}
+
+// The log files in dir with the given prefix and suffix, by sequence number.
+inline std::vector<std::pair<std::uint64_t, std::string>> list_log_files(
+    const std::string& dir, const char* prefix, const char* suffix) {
+  std::vector<std::pair<std::uint64_t, std::string>> files;
+  DIR* d = ::opendir(dir.c_str());
+  if (!d) {
+    throw std::system_error(errno, std::generic_category(), "opendir " + dir);
+  }
+  std::string pattern = std::string(prefix) + "-%20" SCNu64 ".%15s";
+  while (auto entry = ::readdir(d)) {
+    std::uint64_t seq;
+    char rest[16];
+    if (std::sscanf(entry->d_name, pattern.c_str(), &seq, rest) == 2 &&
+        std::string(rest) == suffix) {
+      files.emplace_back(seq, dir + "/" + entry->d_name);
+    }
+  }
+  ::closedir(d);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+// Makes the names of the files in dir, such as one just renamed, durable.
+inline void sync_dir(const std::string& dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + dir);
+  }
+  int rc = ::fsync(fd);
+  int err = errno;
+  ::close(fd);
+  if (rc != 0) {
+    throw std::system_error(err, std::generic_category(), "fsync " + dir);
+  }
+}
+
+// Calls f with a reader positioned at each record of a segment; f must read
+// the record.  A truncated record at the end, as left by a crash part way
+// through an append, ends the segment.
+template <typename F>
+void for_each_record(const std::string& path, F&& f) {
+  mapped_file file(path);
+  reader r(file.data(), file.size());
+  try {
+    while (!r.empty()) {
+      f(r);
+    }
+  } catch (const deserialize_error& e) {
+    if (!e.truncated()) {
+      throw;
+    }
+  }
+}
+
+}  // namespace detail
+
+// An append-only log of Event variants, stored in dir as a series of
+// segment files of about segment_size bytes each, alongside snapshots of the
+// state built from the events.  Opening an existing log appends to it in a
+// new segment.
+template <typename Event>
+class event_log {
+ private:
+  std::string m_dir;
+  std::size_t m_segment_size;
+  std::uint64_t m_size = 0;
+  std::FILE* m_segment = nullptr;
+  std::size_t m_segment_bytes = 0;
+  std::string m_buffer;
+
+  static constexpr std::size_t buffer_size = 1 << 20;
+
+  void write_buffer() {
+    if (!m_buffer.empty() &&
+        std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_segment) !=
+            m_buffer.size()) {
+      throw std::system_error(errno, std::generic_category(),
+                              "write to " + m_dir);
+    }
+    m_buffer.clear();
+  }
+
+  void close_segment() {
+    if (m_segment) {
+      write_buffer();
+      std::fclose(m_segment);
+      m_segment = nullptr;
+    }
+  }
+
+  void open_segment() {
+    auto path = detail::log_file_name(m_dir, "segment", m_size, "log");
+    m_segment = std::fopen(path.c_str(), "wb");
+    if (!m_segment) {
+      throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    m_segment_bytes = 0;
+  }
+
+ public:
+  explicit event_log(std::string dir, std::size_t segment_size = 64 << 20)
+      : m_dir(std::move(dir)), m_segment_size(segment_size) {
+    if (::mkdir(m_dir.c_str(), 0777) != 0 && errno != EEXIST) {
+      throw std::system_error(errno, std::generic_category(),
+                              "mkdir " + m_dir);
+    }
+    auto segments = detail::list_log_files(m_dir, "segment", "log");
+    if (!segments.empty()) {
+      m_size = segments.back().first;
+      detail::for_each_record(segments.back().second, [this](reader& r) {
+        deserialize_view<Event>(r);
+        ++m_size;
+      });
+    }
+    m_buffer.reserve(buffer_size);
+  }
+
+  event_log(const event_log&) = delete;
+  event_log& operator=(const event_log&) = delete;
+
+  ~event_log() {
+    try {
+      close_segment();
+    } catch (const std::system_error&) {
+    }
+  }
+
+  const std::string& dir() const { return m_dir; }
+
+  // Number of events in the log.
+  std::uint64_t size() const { return m_size; }
+
+  void append(const Event& e) {
+    if (!m_segment) {
+      open_segment();
+    }
+    auto before = m_buffer.size();
+    writer w(m_buffer);
+    serialize(w, e);
+    m_segment_bytes += m_buffer.size() - before;
+    ++m_size;
+    if (m_segment_bytes >= m_segment_size) {
+      close_segment();
+    } else if (m_buffer.size() >= buffer_size) {
+      write_buffer();
+    }
+  }
+
+  // Writes buffered events to the current segment.
+  void flush() {
+    if (m_segment) {
+      write_buffer();
+      if (std::fflush(m_segment) != 0) {
+        throw std::system_error(errno, std::generic_category(),
+                                "flush " + m_dir);
+      }
+    }
+  }
+
+  // Records s as the state after every event appended so far, so that
+  // replay can start from it.  Call this periodically, e.g. every few million
+  // events, to bound the time a replay takes.  Later events go to a new
+  // segment, so a replay from the snapshot does not read earlier ones.
+  template <typename State>
+  void snapshot(const State& s) {
+    close_segment();
+    auto path = detail::log_file_name(m_dir, "snapshot", m_size, "state");
+    auto tmp = path + ".tmp";
+    auto bytes = serialize(s);
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+      throw std::system_error(errno, std::generic_category(), "open " + tmp);
+    }
+    // The snapshot must reach the disk before the rename does, or a crash
+    // could leave a snapshot file with missing contents.
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size() &&
+              std::fflush(f) == 0 && ::fsync(::fileno(f)) == 0;
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+      throw std::system_error(errno, std::generic_category(), "write " + path);
+    }
+    detail::sync_dir(m_dir);
+  }
+};
+
+// Rebuilds the state of the log in dir by applying s = transition(s, e) to
+// each event e, starting from the latest snapshot, or from initial if there
+// is none.  Segments are mapped into memory and decoded in place.
+template <typename Event, typename State, typename F>
+State replay(const std::string& dir, State initial, F&& transition) {
+  std::uint64_t from = 0;
+  auto snapshots = detail::list_log_files(dir, "snapshot", "state");
+  if (!snapshots.empty()) {
+    mapped_file file(snapshots.back().second);
+    reader r(file.data(), file.size());
+    initial = deserialize<State>(r);
+    from = snapshots.back().first;
+  }
+
+  State s = std::move(initial);
+  auto segments = detail::list_log_files(dir, "segment", "log");
+  for (std::size_t i = 0; i < segments.size(); ++i) {
+    if (i + 1 < segments.size() && segments[i + 1].first <= from) {
+      continue;
+    }
+    auto seq = segments[i].first;
+    detail::for_each_record(segments[i].second, [&](reader& r) {
+      if (seq++ < from) {
+        deserialize_view<Event>(r);
+      } else {
+        s = transition(s, deserialize<Event>(r));
+      }
+    });
+  }
+  return s;
+}
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef INCLUDED_TOBY_FORMAT_H
+#define INCLUDED_TOBY_FORMAT_H
+
+#include "variant.hpp"
+
+#include <spdlog/fmt/fmt.h>
+
+// fmt 5 and newer are extended through fmt::formatter specialisations; the
+// fmt 3 bundled with older spdlog releases instead looks up a format_arg
+// overload next to the formatted type.  Both write the active alternative
+// straight into fmt's output buffer, so logging a variant does not go
+// through a std::ostream.
+#if FMT_VERSION >= 50000
+
+namespace toby {
+
+// Base for fmt::formatter specialisations that take no format spec.
+struct plain_formatter {
+  template <typename ParseContext>
+  constexpr auto parse(ParseContext& ctx) {
+    return ctx.begin();
+  }
+};
+
+}  // namespace toby
+
+namespace fmt {
+
+// Formats a variant the same way as its operator<<.
+template <typename... Ts>
+struct formatter<toby::variant<Ts...>> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const toby::variant<Ts...>& v, FormatContext& ctx) const {
+    auto out = fmt::format_to(ctx.out(), "variant[{}]: ",
+                              static_cast<unsigned>(v.tag));
+    return v.template visit<decltype(out)>(
+        [out](const auto& x) { return fmt::format_to(out, "{}", x); });
+  }
+};
+
+}  // namespace fmt
+
+#else
+
+namespace toby {
+
+// Formats a variant the same way as its operator<<.
+template <typename ArgFormatter, typename... Ts>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const variant<Ts...>& v) {
+  f.writer().write("variant[{}]: ", static_cast<unsigned>(v.tag));
+  v.template visit<void>([&f](const auto& x) { f.writer().write("{}", x); });
+}
+
+}  // namespace toby
+
+#endif
+
+#endif
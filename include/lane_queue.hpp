@@ -0,0 +1,168 @@
+#ifndef INCLUDED_TOBY_LANE_QUEUE_H
+#define INCLUDED_TOBY_LANE_QUEUE_H
+
+#include "latency_histogram.hpp"
+#include "variant.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+// The lane of alternative T in a lane_queue.  Lanes with higher numbers are
+// drained first; specialise it for urgent alternatives.
+template <typename T, typename Enable = void>
+struct priority_lane : std::integral_constant<std::size_t, 0> {};
+
+struct lane_stats {
+  std::size_t depth = 0;
+  std::size_t peak_depth = 0;
+  std::uint64_t pushed = 0;
+  std::uint64_t popped = 0;
+  // Time from push to pop.
+  latency_histogram latency;
+};
+
+namespace detail {
+template <std::size_t... Ns>
+struct max_of;
+
+template <>
+struct max_of<> : std::integral_constant<std::size_t, 0> {};
+
+template <std::size_t N, std::size_t... Ns>
+struct max_of<N, Ns...>
+    : std::integral_constant<std::size_t, (N > max_of<Ns...>::value
+                                               ? N
+                                               : max_of<Ns...>::value)> {};
+}  // namespace detail
+
+template <typename Event>
+class lane_queue;
+
+// A queue of variants with one FIFO lane per priority_lane value.  pop()
+// takes from the highest non-empty lane, except that a waiting lower lane
+// that starvation_limit pops have passed over is served next, the lowest
+// first if there are several.  Urgent events so wait only for other urgent
+// events, and nothing waits forever.
+template <typename... Ts>
+class lane_queue<variant<Ts...>> {
+ public:
+  using event = variant<Ts...>;
+  using clock = std::chrono::steady_clock;
+  static constexpr std::size_t lanes =
+      detail::max_of<priority_lane<Ts>::value...>::value + 1;
+
+ private:
+  struct lane {
+    std::deque<std::pair<event, clock::time_point>> events;
+    lane_stats stats;
+    // Pops that have passed over this lane since it was last served.
+    std::size_t passed = 0;
+  };
+
+  std::array<lane, lanes> m_lanes;
+  std::size_t m_size = 0;
+  std::size_t m_starvation_limit;
+
+  std::size_t next_lane() {
+    auto next = lanes - 1;
+    while (m_lanes[next].events.empty()) {
+      --next;
+    }
+    auto top = next;
+    for (std::size_t i = 0; i < top; ++i) {
+      if (!m_lanes[i].events.empty() &&
+          m_lanes[i].passed >= m_starvation_limit) {
+        next = i;
+        break;
+      }
+    }
+    for (std::size_t i = 0; i < top; ++i) {
+      if (i != next && !m_lanes[i].events.empty()) {
+        ++m_lanes[i].passed;
+      }
+    }
+    m_lanes[next].passed = 0;
+    return next;
+  }
+
+ public:
+  explicit lane_queue(std::size_t starvation_limit = 64)
+      : m_starvation_limit(starvation_limit) {}
+
+  // Queues e, an alternative or an event, at the back of its lane.
+  template <typename T, typename = std::enable_if_t<
+                            detail::is_one_of<std::decay_t<T>, Ts...>::value>>
+  void push(T&& e) {
+    auto& l = m_lanes[priority_lane<std::decay_t<T>>::value];
+    l.events.emplace_back(std::forward<T>(e), clock::now());
+    auto& s = l.stats;
+    ++s.pushed;
+    s.peak_depth = std::max(s.peak_depth, ++s.depth);
+    ++m_size;
+  }
+  void push(const event& e) {
+    e.template visit<void>(
+        [this](const auto& alternative) { this->push(alternative); });
+  }
+  void push(event&& e) {
+    std::move(e).template visit<void>(
+        [this](auto&& alternative) { this->push(std::move(alternative)); });
+  }
+
+  bool empty() const noexcept { return m_size == 0; }
+  std::size_t size() const noexcept { return m_size; }
+
+  // Calls f with up to max events, as rvalues, in the order the scheduler
+  // picks them, and removes them.  Returns the number consumed.  Each event
+  // is removed before f is called, so f may push or consume more; if f
+  // throws, the event is put back at the front of its lane.
+  template <typename F>
+  std::size_t consume(F&& f, std::size_t max) {
+    std::size_t n = 0;
+    for (; n != max && m_size != 0; ++n) {
+      auto& l = m_lanes[next_lane()];
+      auto front = std::move(l.events.front());
+      l.events.pop_front();
+      --l.stats.depth;
+      --m_size;
+      try {
+        f(std::move(front.first));
+      } catch (...) {
+        l.events.push_front(std::move(front));
+        ++l.stats.depth;
+        ++m_size;
+        throw;
+      }
+      l.stats.latency.record(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              clock::now() - front.second)
+              .count()));
+      ++l.stats.popped;
+    }
+    return n;
+  }
+
+  // Moves the next event into e, or returns false if the queue is empty.
+  bool try_pop(event& e) {
+    return consume([&e](event&& v) { e = std::move(v); }, 1) == 1;
+  }
+
+  const lane_stats& stats(std::size_t lane) const {
+    return m_lanes[lane].stats;
+  }
+};
+
+template <typename... Ts>
+constexpr std::size_t lane_queue<variant<Ts...>>::lanes;
+
+}  // namespace toby
+
+#endif
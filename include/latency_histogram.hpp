@@ -0,0 +1,64 @@
+#ifndef INCLUDED_TOBY_LATENCY_HISTOGRAM_H
+#define INCLUDED_TOBY_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace toby {
+
+// A histogram of durations in nanoseconds with four buckets per power of
+// two, so percentiles are accurate to within a quarter.
+class latency_histogram {
+ private:
+  static constexpr std::size_t sub_buckets = 4;
+  std::array<std::uint64_t, 64 * sub_buckets> m_counts{};
+  std::uint64_t m_count = 0;
+
+  static std::size_t bucket(std::uint64_t ns) {
+    if (ns < sub_buckets) {
+      return static_cast<std::size_t>(ns);
+    }
+    std::size_t log = 63;
+    while (!(ns >> log)) {
+      --log;
+    }
+    auto sub = (ns >> (log - 2)) & (sub_buckets - 1);
+    return (log - 1) * sub_buckets + static_cast<std::size_t>(sub);
+  }
+  // The largest duration that falls into bucket b.
+  static std::uint64_t upper_bound(std::size_t b) {
+    if (b < sub_buckets) {
+      return b;
+    }
+    auto log = b / sub_buckets + 1;
+    auto sub = b % sub_buckets;
+    return ((sub_buckets + sub + 1) << (log - 2)) - 1;
+  }
+
+ public:
+  void record(std::uint64_t ns) {
+    ++m_counts[bucket(ns)];
+    ++m_count;
+  }
+
+  std::uint64_t count() const noexcept { return m_count; }
+
+  // The duration below which a fraction p of the samples fall, rounded up
+  // to the end of its bucket, or 0 if there are none.
+  std::uint64_t percentile(double p) const {
+    auto rank = static_cast<std::uint64_t>(p * static_cast<double>(m_count));
+    std::uint64_t seen = 0;
+    for (std::size_t b = 0; b < m_counts.size(); ++b) {
+      seen += m_counts[b];
+      if (seen > rank || (seen == m_count && m_count != 0)) {
+        return upper_bound(b);
+      }
+    }
+    return 0;
+  }
+};
+
+}  // namespace toby
+
+#endif
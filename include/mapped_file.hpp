@@ -0,0 +1,73 @@
+#ifndef INCLUDED_TOBY_MAPPED_FILE_H
+#define INCLUDED_TOBY_MAPPED_FILE_H
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace toby {
+
+// A read-only memory mapping of a whole file.
+class mapped_file {
+ private:
+  const char* m_data = nullptr;
+  std::size_t m_size = 0;
+
+  static std::system_error error(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+  }
+
+ public:
+  explicit mapped_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw error("open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      auto e = error("stat " + path);
+      ::close(fd);
+      throw e;
+    }
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size > 0) {
+      void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        auto e = error("mmap " + path);
+        ::close(fd);
+        throw e;
+      }
+      m_data = static_cast<const char*>(p);
+    }
+    ::close(fd);
+  }
+
+  mapped_file(mapped_file&& other) noexcept
+      : m_data(std::exchange(other.m_data, nullptr)),
+        m_size(std::exchange(other.m_size, 0)) {}
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    return *this;
+  }
+
+  ~mapped_file() {
+    if (m_data) {
+      ::munmap(const_cast<char*>(m_data), m_size);
+    }
+  }
+
+  const char* data() const noexcept { return m_data; }
+  std::size_t size() const noexcept { return m_size; }
+};
+
+}  // namespace toby
+
+#endif
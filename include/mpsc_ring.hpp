@@ -0,0 +1,200 @@
+#ifndef INCLUDED_TOBY_MPSC_RING_H
+#define INCLUDED_TOBY_MPSC_RING_H
+
+#include "variant.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+template <typename Event>
+class mpsc_ring;
+
+// A bounded lock-free queue of variants for any number of producer threads
+// and one consumer thread.  Each slot holds a sequence number, a tag and
+// the storage of an alternative; a producer claims a slot by advancing the
+// head with a compare-and-swap, constructs the alternative in the slot and
+// publishes it through the sequence number, and the consumer hands it to a
+// visitor straight from the slot.  When every alternative is trivially
+// copyable, pushing an event copies its bytes without visiting it and
+// consuming skips the destructors.
+template <typename... Ts>
+class mpsc_ring<variant<Ts...>> {
+ public:
+  using event = variant<Ts...>;
+
+ private:
+  using helper = detail::variant_helper<Ts...>;
+  using super_visit = typename helper::super_visit;
+  using tag_type = typename helper::tag_type;
+  using trivial = detail::all_of<std::is_trivially_copyable<Ts>::value...>;
+  static constexpr std::size_t cache_line = 64;
+  // The tag of a slot whose element threw while being constructed.
+  static constexpr tag_type tombstone = sizeof...(Ts);
+
+  struct slot {
+    std::atomic<std::size_t> sequence;
+    tag_type tag;
+    std::aligned_union_t<0, char, Ts...> storage;
+  };
+
+  std::size_t m_mask;
+  std::unique_ptr<slot[]> m_slots;
+
+  char m_pad0[cache_line];
+  // Claimed by producers.
+  std::atomic<std::size_t> m_head{0};
+  char m_pad1[cache_line];
+  // Only touched by the consumer.
+  std::size_t m_tail = 0;
+  char m_pad2[cache_line];
+
+  static std::size_t checked(std::size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+      throw std::invalid_argument("mpsc_ring capacity must be a power of two");
+    }
+    return capacity;
+  }
+
+  // Claims the slot for the next element, or returns nullptr if the ring is
+  // full.
+  slot* claim(std::size_t& pos) {
+    pos = m_head.load(std::memory_order_relaxed);
+    for (;;) {
+      auto& s = m_slots[pos & m_mask];
+      auto sequence = s.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(sequence - pos);
+      if (diff == 0) {
+        if (m_head.compare_exchange_weak(pos, pos + 1,
+                                         std::memory_order_relaxed)) {
+          return &s;
+        }
+      } else if (diff < 0) {
+        return nullptr;
+      } else {
+        pos = m_head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool push_event(const event& e, std::true_type) {
+    std::size_t pos;
+    auto s = claim(pos);
+    if (!s) {
+      return false;
+    }
+    std::memcpy(&s->storage, &e.storage, sizeof(s->storage));
+    s->tag = e.tag;
+    s->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+  bool push_event(const event& e, std::false_type) {
+    return e.template visit<bool>([this](const auto& alternative) {
+      return this->try_push(alternative);
+    });
+  }
+  bool push_event(event&& e, std::false_type) {
+    return std::move(e).template visit<bool>([this](auto&& alternative) {
+      return this->try_push(std::move(alternative));
+    });
+  }
+
+  static void destroy(slot&, std::true_type) {}
+  static void destroy(slot& s, std::false_type) {
+    super_visit::template visit_helper_rvalue<void>(
+        s.tag, &s.storage, [](auto&& value) {
+          using T = std::decay_t<decltype(value)>;
+          value.~T();
+        });
+  }
+
+ public:
+  // capacity must be a power of two.
+  explicit mpsc_ring(std::size_t capacity)
+      : m_mask(checked(capacity) - 1), m_slots(new slot[capacity]) {
+    for (std::size_t i = 0; i < capacity; ++i) {
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpsc_ring(const mpsc_ring&) = delete;
+  mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+  ~mpsc_ring() {
+    consume([](auto&&) {}, capacity());
+  }
+
+  std::size_t capacity() const noexcept { return m_mask + 1; }
+
+  // Producer: constructs a T from args in a free slot, or returns false if
+  // the ring is full.  If the constructor throws, the slot is published as
+  // a tombstone that the consumer skips, so the ring keeps working.
+  template <typename T, typename... Args>
+  bool try_emplace(Args&&... args) {
+    static_assert(detail::is_one_of<T, Ts...>::value,
+                  "T must be an alternative of the variant");
+    std::size_t pos;
+    auto s = claim(pos);
+    if (!s) {
+      return false;
+    }
+    try {
+      new (&s->storage) T(std::forward<Args>(args)...);
+    } catch (...) {
+      s->tag = tombstone;
+      s->sequence.store(pos + 1, std::memory_order_release);
+      throw;
+    }
+    s->tag = detail::index_of<T, Ts...>::value;
+    s->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+  template <typename T, typename = std::enable_if_t<
+                            detail::is_one_of<std::decay_t<T>, Ts...>::value>>
+  bool try_push(T&& value) {
+    return try_emplace<std::decay_t<T>>(std::forward<T>(value));
+  }
+  bool try_push(const event& e) { return push_event(e, trivial()); }
+  bool try_push(event&& e) { return push_event(std::move(e), trivial()); }
+
+  // Consumer: visits up to max published elements from the front with
+  // visitor, passing each alternative as an rvalue, and removes them.
+  // Returns the number consumed.  visitor must not throw.
+  template <typename F>
+  std::size_t consume(F&& visitor, std::size_t max) {
+    std::size_t n = 0;
+    while (n != max) {
+      auto& s = m_slots[m_tail & m_mask];
+      if (s.sequence.load(std::memory_order_acquire) != m_tail + 1) {
+        break;
+      }
+      if (s.tag != tombstone) {
+        super_visit::template visit_helper_rvalue<void>(s.tag, &s.storage,
+                                                        visitor);
+        destroy(s, trivial());
+        ++n;
+      }
+      s.sequence.store(m_tail + capacity(), std::memory_order_release);
+      ++m_tail;
+    }
+    return n;
+  }
+
+  // Consumer: moves the front element into e, or returns false if there is
+  // none.
+  bool try_pop(event& e) {
+    return consume([&e](auto&& value) { e = std::move(value); }, 1) == 1;
+  }
+};
+
+}  // namespace toby
+
+#endif
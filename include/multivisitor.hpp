@@ -3,12 +3,15 @@
 
 #include "overload_set.hpp"
 
+#include <cstddef>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace toby {
 
 namespace detail {
-template <typename Callable, typename Tuple, size_t... I>
+template <typename Callable, typename Tuple, std::size_t... I>
 auto apply_impl(Callable&& f, Tuple&& t, std::index_sequence<I...>) {
   return f(std::get<I>(t)...);
 }
@@ -22,9 +25,15 @@ auto apply(Callable&& f, Tuple&& t) {
                             is());
 }
 
+template <typename R, typename F, typename T>
+class bound_multivisitor;
+
 template <typename R, typename F>
 class multivisitor {
  private:
+  template <typename, typename, typename>
+  friend class bound_multivisitor;
+
   F m_f;
 
  public:
@@ -35,10 +44,20 @@ class multivisitor {
     return collect(std::tuple<>(), args...);
   }
 
+  // Resolves the alternative of first once and calls k with a dispatcher on
+  // the remaining arguments: bound(args...) is (*this)(first, args...), but
+  // only visits args.
+  template <typename V, typename K>
+  void bind_first(const V& first, K&& k) {
+    first.template visit<void>([&](const auto& v) {
+      k(bound_multivisitor<R, F, std::decay_t<decltype(v)>>(*this, v));
+    });
+  }
+
  private:
   template <typename... Ts>
   auto collect(const std::tuple<Ts...>& t) {
-    return apply(m_f, t);
+    return toby::apply(m_f, t);
   }
 
   template <typename... Ts, typename V, typename... Vs>
@@ -50,6 +69,28 @@ class multivisitor {
   }
 };
 
+// A multivisitor whose first argument is a T.  It refers to the multivisitor
+// and the T, so it must not outlive either.
+template <typename R, typename F, typename T>
+class bound_multivisitor {
+ private:
+  multivisitor<R, F>& m_visitor;
+  const T& m_first;
+
+ public:
+  using first_type = T;
+
+  bound_multivisitor(multivisitor<R, F>& visitor, const T& first)
+      : m_visitor(visitor), m_first(first) {}
+
+  const T& first() const { return m_first; }
+
+  template <typename... Vs>
+  auto operator()(const Vs&... args) const {
+    return m_visitor.collect(std::tuple<const T&>(m_first), args...);
+  }
+};
+
 template <typename T, typename F>
 auto make_multivisitor(F&& f) {
   return multivisitor<T, F>(std::forward<F>(f));
@@ -0,0 +1,92 @@
+#ifndef INCLUDED_TOBY_OPTIONAL_H
+#define INCLUDED_TOBY_OPTIONAL_H
+
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+// Just enough of C++17's std::optional for results that may be absent.
+template <typename T>
+class optional {
+ private:
+  std::aligned_storage_t<sizeof(T), alignof(T)> m_storage;
+  bool m_engaged = false;
+
+  T* get() { return reinterpret_cast<T*>(&m_storage); }
+  const T* get() const { return reinterpret_cast<const T*>(&m_storage); }
+
+ public:
+  optional() noexcept {}
+  optional(const T& value) { emplace(value); }
+  optional(T&& value) { emplace(std::move(value)); }
+
+  optional(const optional& other) {
+    if (other) emplace(*other);
+  }
+  optional(optional&& other) noexcept(
+      std::is_nothrow_move_constructible<T>::value) {
+    if (other) emplace(std::move(*other));
+  }
+
+  optional& operator=(const optional& other) {
+    if (this != &other) {
+      reset();
+      if (other) emplace(*other);
+    }
+    return *this;
+  }
+  optional& operator=(optional&& other) noexcept(
+      std::is_nothrow_move_constructible<T>::value) {
+    if (this != &other) {
+      reset();
+      if (other) emplace(std::move(*other));
+    }
+    return *this;
+  }
+
+  ~optional() { reset(); }
+
+  template <typename... Args>
+  T& emplace(Args&&... args) {
+    reset();
+    new (&m_storage) T(std::forward<Args>(args)...);
+    m_engaged = true;
+    return *get();
+  }
+
+  void reset() noexcept {
+    if (m_engaged) {
+      get()->~T();
+      m_engaged = false;
+    }
+  }
+
+  bool has_value() const noexcept { return m_engaged; }
+  explicit operator bool() const noexcept { return m_engaged; }
+
+  T& operator*() & { return *get(); }
+  const T& operator*() const& { return *get(); }
+  T&& operator*() && { return std::move(*get()); }
+  T* operator->() { return get(); }
+  const T* operator->() const { return get(); }
+
+  T& value() & {
+    if (!m_engaged) throw std::logic_error("optional is empty");
+    return *get();
+  }
+  const T& value() const& {
+    if (!m_engaged) throw std::logic_error("optional is empty");
+    return *get();
+  }
+  T&& value() && {
+    if (!m_engaged) throw std::logic_error("optional is empty");
+    return std::move(*get());
+  }
+};
+
+}  // namespace toby
+
+#endif
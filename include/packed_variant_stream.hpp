@@ -0,0 +1,204 @@
+#ifndef INCLUDED_TOBY_PACKED_VARIANT_STREAM_H
+#define INCLUDED_TOBY_PACKED_VARIANT_STREAM_H
+
+#include "relocate.hpp"
+#include "variant.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+// A sequence of values of any of Ts, stored back to back in one buffer.  Each
+// element takes the bytes of its tag, padding to the alignment of its
+// alternative, and the alternative itself, rather than the size of the
+// largest alternative as in a container of variant<Ts...>.  Elements can be
+// appended and visited in order through variant_views.
+template <typename... Ts>
+class packed_variant_stream {
+ private:
+  using helper = detail::variant_helper<Ts...>;
+  using super_visit = typename helper::super_visit;
+  using tag_type = typename helper::tag_type;
+
+  static_assert(detail::all_of<(alignof(Ts) <=
+                                alignof(std::max_align_t))...>::value,
+                "over-aligned alternatives are not supported");
+
+  char* m_data = nullptr;
+  std::size_t m_size = 0;
+  std::size_t m_capacity = 0;
+  std::size_t m_count = 0;
+
+  static std::size_t payload_offset(std::size_t offset, tag_type tag) {
+    static constexpr std::size_t alignments[] = {alignof(Ts)...};
+    auto a = alignments[tag];
+    return (offset + sizeof(tag_type) + a - 1) / a * a;
+  }
+  static std::size_t next_offset(std::size_t offset, tag_type tag) {
+    static constexpr std::size_t sizes[] = {sizeof(Ts)...};
+    return payload_offset(offset, tag) + sizes[tag];
+  }
+  static tag_type tag_at(const char* data, std::size_t offset) {
+    tag_type tag;
+    std::memcpy(&tag, data + offset, sizeof(tag));
+    return tag;
+  }
+
+  void relocate(char* to, std::true_type) {
+    if (m_size != 0) {
+      std::memcpy(to, m_data, m_size);
+    }
+  }
+  void relocate(char* to, std::false_type) {
+    for (std::size_t offset = 0; offset != m_size;) {
+      auto tag = tag_at(m_data, offset);
+      auto payload = payload_offset(offset, tag);
+      std::memcpy(to + offset, m_data + offset, sizeof(tag));
+      super_visit::template visit_helper_rvalue<void>(
+          tag, m_data + payload, [to, payload](auto&& value) {
+            using T = std::decay_t<decltype(value)>;
+            relocate_at(&value, reinterpret_cast<T*>(to + payload));
+          });
+      offset = next_offset(offset, tag);
+    }
+  }
+
+  void grow(std::size_t min_capacity) {
+    auto capacity = m_capacity < 64 ? 128 : 2 * m_capacity;
+    if (capacity < min_capacity) {
+      capacity = min_capacity;
+    }
+    auto data = static_cast<char*>(::operator new(capacity));
+    relocate(data, detail::all_trivially_relocatable<Ts...>());
+    ::operator delete(m_data);
+    m_data = data;
+    m_capacity = capacity;
+  }
+
+  void destroy(std::true_type) {}
+  void destroy(std::false_type) {
+    for (std::size_t offset = 0; offset != m_size;) {
+      auto tag = tag_at(m_data, offset);
+      super_visit::template visit_helper_rvalue<void>(
+          tag, m_data + payload_offset(offset, tag), [](auto&& value) {
+            using T = std::decay_t<decltype(value)>;
+            value.~T();
+          });
+      offset = next_offset(offset, tag);
+    }
+  }
+
+ public:
+  class const_iterator {
+   private:
+    const char* m_data;
+    std::size_t m_offset;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = variant_view<Ts...>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    const_iterator(const char* data, std::size_t offset) noexcept
+        : m_data(data), m_offset(offset) {}
+
+    value_type operator*() const {
+      auto tag = tag_at(m_data, m_offset);
+      return value_type(m_data + payload_offset(m_offset, tag), tag);
+    }
+    const_iterator& operator++() {
+      m_offset = next_offset(m_offset, tag_at(m_data, m_offset));
+      return *this;
+    }
+    const_iterator operator++(int) {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+
+    friend bool operator==(const const_iterator& a, const const_iterator& b) {
+      return a.m_offset == b.m_offset;
+    }
+    friend bool operator!=(const const_iterator& a, const const_iterator& b) {
+      return a.m_offset != b.m_offset;
+    }
+  };
+
+  packed_variant_stream() noexcept {}
+  packed_variant_stream(const packed_variant_stream&) = delete;
+  packed_variant_stream& operator=(const packed_variant_stream&) = delete;
+  packed_variant_stream(packed_variant_stream&& other) noexcept
+      : m_data(std::exchange(other.m_data, nullptr)),
+        m_size(std::exchange(other.m_size, 0)),
+        m_capacity(std::exchange(other.m_capacity, 0)),
+        m_count(std::exchange(other.m_count, 0)) {}
+  packed_variant_stream& operator=(packed_variant_stream&& other) noexcept {
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_capacity, other.m_capacity);
+    std::swap(m_count, other.m_count);
+    return *this;
+  }
+  ~packed_variant_stream() {
+    clear();
+    ::operator delete(m_data);
+  }
+
+  template <typename T, typename... Args>
+  T& emplace(Args&&... args) {
+    constexpr auto tag = detail::index_of<T, Ts...>::value;
+    static_assert(tag < sizeof...(Ts), "T is not one of Ts");
+    auto payload = payload_offset(m_size, tag);
+    auto end = payload + sizeof(T);
+    if (end > m_capacity) {
+      grow(end);
+    }
+    auto p = new (m_data + payload) T(std::forward<Args>(args)...);
+    auto t = static_cast<tag_type>(tag);
+    std::memcpy(m_data + m_size, &t, sizeof(t));
+    m_size = end;
+    ++m_count;
+    return *p;
+  }
+
+  template <typename T, typename = std::enable_if_t<
+                            detail::is_one_of<std::decay_t<T>, Ts...>::value>>
+  void push(T&& value) {
+    emplace<std::decay_t<T>>(std::forward<T>(value));
+  }
+  void push(const variant<Ts...>& v) {
+    v.template visit<void>([this](const auto& value) { this->push(value); });
+  }
+  void push(variant<Ts...>&& v) {
+    std::move(v).template visit<void>(
+        [this](auto&& value) { this->push(std::move(value)); });
+  }
+
+  // Destroys every element, keeping the buffer for reuse.
+  void clear() noexcept {
+    destroy(detail::all_of<std::is_trivially_destructible<Ts>::value...>());
+    m_size = 0;
+    m_count = 0;
+  }
+
+  const_iterator begin() const noexcept { return {m_data, 0}; }
+  const_iterator end() const noexcept { return {m_data, m_size}; }
+
+  bool empty() const noexcept { return m_count == 0; }
+  // Number of elements.
+  std::size_t size() const noexcept { return m_count; }
+  // Number of bytes the elements take up.
+  std::size_t bytes() const noexcept { return m_size; }
+  std::size_t capacity() const noexcept { return m_capacity; }
+};
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef INCLUDED_TOBY_PARALLEL_H
+#define INCLUDED_TOBY_PARALLEL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace toby {
+
+// A fixed set of worker threads that run one job at a time, fork-join
+// style.  The thread calling run() takes part as worker 0.  Jobs must not
+// call run() on the same pool.
+class thread_pool {
+ private:
+  std::vector<std::thread> m_threads;
+  std::mutex m_run_mutex;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  const std::function<void(std::size_t)>* m_job = nullptr;
+  std::uint64_t m_generation = 0;
+  std::size_t m_running = 0;
+  std::exception_ptr m_error;
+  bool m_stopping = false;
+
+  void work(std::size_t index) {
+    std::uint64_t generation = 0;
+    for (;;) {
+      const std::function<void(std::size_t)>* job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [&] {
+          return m_stopping || m_generation != generation;
+        });
+        if (m_stopping) {
+          return;
+        }
+        generation = m_generation;
+        job = m_job;
+      }
+      std::exception_ptr error;
+      try {
+        (*job)(index);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (error && !m_error) {
+        m_error = error;
+      }
+      if (--m_running == 0) {
+        m_done.notify_one();
+      }
+    }
+  }
+
+ public:
+  // A pool of threads workers in total, including the caller of run().
+  explicit thread_pool(
+      std::size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+    for (std::size_t i = 1; i < threads; ++i) {
+      m_threads.emplace_back([this, i] { work(i); });
+    }
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& t : m_threads) {
+      t.join();
+    }
+  }
+
+  // Number of workers, including the caller of run().
+  std::size_t size() const noexcept { return m_threads.size() + 1; }
+
+  // Calls job(i) on worker i for every i below size(), and returns once they
+  // have all returned.  Rethrows the first exception a worker threw.
+  void run(const std::function<void(std::size_t)>& job) {
+    std::lock_guard<std::mutex> run_lock(m_run_mutex);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_job = &job;
+      m_running = m_threads.size();
+      m_error = nullptr;
+      ++m_generation;
+    }
+    m_wake.notify_all();
+    std::exception_ptr error;
+    try {
+      job(0);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_running == 0; });
+    if (!error) {
+      error = m_error;
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  // A pool with a worker per core, shared by the whole process.
+  static thread_pool& shared() {
+    static thread_pool pool;
+    return pool;
+  }
+};
+
+namespace detail {
+constexpr std::size_t cache_line = 64;
+
+struct work_range {
+  std::mutex mutex;
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  char pad[cache_line];
+};
+
+template <typename T>
+struct padded {
+  T value;
+  char pad[cache_line];
+};
+}  // namespace detail
+
+// Calls body(begin, end, worker) on chunks that together cover [0, n), on
+// the workers of pool.  Each worker starts with an equal share of the
+// indexes and takes chunks from the front of it, doubling the chunk size
+// each time up to half of what remains.  A worker that runs out steals the
+// back half of another worker's remaining share and starts again with small
+// chunks, so shares that turn out to be expensive are spread over idle
+// workers.
+template <typename F>
+void parallel_for(thread_pool& pool, std::size_t n, F&& body) {
+  const auto workers = pool.size();
+  if (workers == 1 || n < 2) {
+    body(std::size_t(0), n, std::size_t(0));
+    return;
+  }
+  std::vector<detail::work_range> ranges(workers);
+  for (std::size_t w = 0; w < workers; ++w) {
+    ranges[w].begin = n * w / workers;
+    ranges[w].end = n * (w + 1) / workers;
+  }
+
+  pool.run([&](std::size_t w) {
+    static constexpr std::size_t max_chunk = 4096;
+    std::size_t chunk = 1;
+    for (;;) {
+      std::size_t begin = 0;
+      std::size_t end = 0;
+      {
+        auto& own = ranges[w];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        auto remaining = own.end - own.begin;
+        if (remaining != 0) {
+          begin = own.begin;
+          end = begin + std::min(chunk, std::max<std::size_t>(
+                                            1, remaining / 2));
+          own.begin = end;
+        }
+      }
+      if (begin != end) {
+        body(begin, end, w);
+        chunk = std::min(2 * chunk, max_chunk);
+        continue;
+      }
+
+      for (std::size_t k = 1; k < workers && begin == end; ++k) {
+        auto& victim = ranges[(w + k) % workers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        auto remaining = victim.end - victim.begin;
+        if (remaining != 0) {
+          begin = victim.begin + remaining / 2;
+          end = victim.end;
+          victim.end = begin;
+        }
+      }
+      if (begin == end) {
+        return;
+      }
+      auto& own = ranges[w];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      own.begin = begin;
+      own.end = end;
+      chunk = 1;
+    }
+  });
+}
+
+// Visits every variant in [first, last) with f, in parallel on pool.  f may
+// be called from several threads at once.
+template <typename It, typename F>
+void parallel_visit(thread_pool& pool, It first, It last, F&& f) {
+  parallel_for(pool, static_cast<std::size_t>(std::distance(first, last)),
+               [&](std::size_t begin, std::size_t end, std::size_t) {
+                 for (auto i = begin; i != end; ++i) {
+                   first[i].template visit<void>(f);
+                 }
+               });
+}
+template <typename It, typename F>
+void parallel_visit(It first, It last, F&& f) {
+  parallel_visit(thread_pool::shared(), first, last, std::forward<F>(f));
+}
+template <typename Range, typename F>
+void parallel_visit(Range& range, F&& f) {
+  using std::begin;
+  using std::end;
+  parallel_visit(begin(range), end(range), std::forward<F>(f));
+}
+
+// Combines the results of visiting every variant in [first, last) with f,
+// as combine(combine(identity, f(a)), f(b))..., in parallel on pool.  Each
+// chunk of indexes is reduced to a partial result of its own, and the
+// partial results are combined in index order at the end, so combine must
+// be associative, though not commutative, and identity its identity.
+template <typename R, typename It, typename F, typename Combine>
+R parallel_reduce(thread_pool& pool, It first, It last, R identity, F&& f,
+                  Combine&& combine) {
+  using partial = std::pair<std::size_t, R>;
+  std::vector<detail::padded<std::vector<partial>>> partials(pool.size());
+  parallel_for(pool, static_cast<std::size_t>(std::distance(first, last)),
+               [&](std::size_t begin, std::size_t end, std::size_t w) {
+                 auto acc = identity;
+                 for (auto i = begin; i != end; ++i) {
+                   acc = combine(std::move(acc),
+                                 first[i].template visit<R>(f));
+                 }
+                 partials[w].value.emplace_back(begin, std::move(acc));
+               });
+  std::vector<partial> chunks;
+  for (auto& p : partials) {
+    std::move(p.value.begin(), p.value.end(), std::back_inserter(chunks));
+  }
+  std::sort(chunks.begin(), chunks.end(),
+            [](const partial& a, const partial& b) {
+              return a.first < b.first;
+            });
+  auto result = std::move(identity);
+  for (auto& c : chunks) {
+    result = combine(std::move(result), std::move(c.second));
+  }
+  return result;
+}
+template <typename R, typename It, typename F, typename Combine>
+R parallel_reduce(It first, It last, R identity, F&& f, Combine&& combine) {
+  return parallel_reduce(thread_pool::shared(), first, last,
+                         std::move(identity), std::forward<F>(f),
+                         std::forward<Combine>(combine));
+}
+template <typename R, typename Range, typename F, typename Combine>
+R parallel_reduce(Range& range, R identity, F&& f, Combine&& combine) {
+  using std::begin;
+  using std::end;
+  return parallel_reduce(begin(range), end(range), std::move(identity),
+                         std::forward<F>(f), std::forward<Combine>(combine));
+}
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef INCLUDED_TOBY_RELOCATE_H
+#define INCLUDED_TOBY_RELOCATE_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+// A type is trivially relocatable if moving an object to a new address and
+// ending the lifetime of the original can be done by copying its bytes.  This
+// is true of trivially copyable types and, in practice, of most types that do
+// not store pointers into themselves (std::vector, std::unique_ptr, ...), but
+// not of e.g. libstdc++'s std::string.  Specialise this to opt a type in.
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+namespace detail {
+template <typename... Ts>
+struct all_trivially_relocatable;
+
+template <>
+struct all_trivially_relocatable<> : std::true_type {};
+
+template <typename T, typename... Ts>
+struct all_trivially_relocatable<T, Ts...>
+    : std::integral_constant<bool,
+                             is_trivially_relocatable<T>::value &&
+                                 all_trivially_relocatable<Ts...>::value> {};
+
+template <typename T>
+void relocate_at(T* src, T* dst, std::true_type) {
+  std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src),
+              sizeof(T));
+}
+template <typename T>
+void relocate_at(T* src, T* dst, std::false_type) {
+  new (dst) T(std::move(*src));
+  src->~T();
+}
+
+template <typename T>
+T* uninitialized_relocate(T* first, T* last, T* d_first, std::true_type) {
+  auto n = static_cast<std::size_t>(last - first);
+  if (n != 0) {
+    std::memmove(static_cast<void*>(d_first), static_cast<const void*>(first),
+                 n * sizeof(T));
+  }
+  return d_first + n;
+}
+template <typename T>
+T* uninitialized_relocate(T* first, T* last, T* d_first, std::false_type) {
+  for (; first != last; ++first, ++d_first) {
+    relocate_at(first, d_first, std::false_type());
+  }
+  return d_first;
+}
+}
+
+// Moves *src into the uninitialized storage at dst and ends the lifetime of
+// *src.
+template <typename T>
+void relocate_at(T* src, T* dst) {
+  detail::relocate_at(src, dst, is_trivially_relocatable<T>());
+}
+
+// Relocates [first, last) into the uninitialized storage starting at d_first
+// and returns the end of the destination range.  The ranges may only overlap
+// if d_first is before first.
+template <typename T>
+T* uninitialized_relocate(T* first, T* last, T* d_first) {
+  return detail::uninitialized_relocate(first, last, d_first,
+                                        is_trivially_relocatable<T>());
+}
+
+}  // namespace toby
+
+#endif
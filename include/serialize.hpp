@@ -0,0 +1,248 @@
+#ifndef INCLUDED_TOBY_SERIALIZE_H
+#define INCLUDED_TOBY_SERIALIZE_H
+
+#include "string_view.hpp"
+#include "variant.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace toby {
+
+// Thrown when serialized data is truncated or malformed.
+class deserialize_error : public std::runtime_error {
+ private:
+  bool m_truncated;
+
+ public:
+  explicit deserialize_error(const std::string& what, bool truncated = false)
+      : std::runtime_error(what), m_truncated(truncated) {}
+
+  // Whether the data simply ended early, as after a torn write.
+  bool truncated() const noexcept { return m_truncated; }
+};
+
+// Appends serialized bytes to a string.
+class writer {
+ private:
+  std::string* m_out;
+
+ public:
+  explicit writer(std::string& out) noexcept : m_out(&out) {}
+
+  void write(const void* data, std::size_t size) {
+    m_out->append(static_cast<const char*>(data), size);
+  }
+};
+
+// Reads serialized bytes from a buffer it does not own, such as a mapped
+// file.  Views returned while reading point into that buffer.
+class reader {
+ private:
+  const char* m_pos;
+  const char* m_end;
+
+ public:
+  reader(const char* data, std::size_t size) noexcept
+      : m_pos(data), m_end(data + size) {}
+
+  bool empty() const noexcept { return m_pos == m_end; }
+  std::size_t remaining() const noexcept {
+    return static_cast<std::size_t>(m_end - m_pos);
+  }
+  const char* position() const noexcept { return m_pos; }
+
+  // Returns the next size bytes and skips past them.
+  const char* read(std::size_t size) {
+    if (size > remaining()) {
+      throw deserialize_error("serialized data truncated", true);
+    }
+    auto p = m_pos;
+    m_pos += size;
+    return p;
+  }
+};
+
+// How a T is written and read.  write(writer&, const T&) and read(reader&)
+// round-trip a value; view(reader&) returns a view_type, which may refer into
+// the reader's buffer instead of copying out of it.  Arithmetic types, empty
+// types, std::string and variants of serializable types are supported;
+// specialise this for other types.
+template <typename T, typename Enable = void>
+struct serializer;
+
+namespace detail {
+template <std::size_t N>
+struct uint_of_size;
+
+template <>
+struct uint_of_size<1> {
+  using type = std::uint8_t;
+};
+template <>
+struct uint_of_size<2> {
+  using type = std::uint16_t;
+};
+template <>
+struct uint_of_size<4> {
+  using type = std::uint32_t;
+};
+template <>
+struct uint_of_size<8> {
+  using type = std::uint64_t;
+};
+}  // namespace detail
+
+// Arithmetic types are written as their bytes in little-endian order.
+template <typename T>
+struct serializer<T, std::enable_if_t<std::is_arithmetic<T>::value>> {
+  using view_type = T;
+  using bits = typename detail::uint_of_size<sizeof(T)>::type;
+
+  static void write(writer& w, T value) {
+    bits u;
+    std::memcpy(&u, &value, sizeof(u));
+    unsigned char bytes[sizeof(u)];
+    for (std::size_t i = 0; i < sizeof(u); ++i) {
+      bytes[i] = static_cast<unsigned char>(u >> (8 * i));
+    }
+    w.write(bytes, sizeof(bytes));
+  }
+  static T read(reader& r) {
+    auto bytes = reinterpret_cast<const unsigned char*>(r.read(sizeof(bits)));
+    bits u = 0;
+    for (std::size_t i = 0; i < sizeof(u); ++i) {
+      u = static_cast<bits>(u | static_cast<bits>(bytes[i]) << (8 * i));
+    }
+    T value;
+    std::memcpy(&value, &u, sizeof(value));
+    return value;
+  }
+  static T view(reader& r) { return read(r); }
+};
+
+// Empty types take no space.
+template <typename T>
+struct serializer<T, std::enable_if_t<std::is_empty<T>::value>> {
+  using view_type = T;
+
+  static void write(writer&, const T&) {}
+  static T read(reader&) { return T{}; }
+  static T view(reader&) { return T{}; }
+};
+
+// Strings are written as a 32-bit length followed by their characters.
+template <>
+struct serializer<std::string> {
+  using view_type = string_view;
+  using length = std::uint32_t;
+
+  static void write(writer& w, const std::string& s) {
+    if (s.size() > std::numeric_limits<length>::max()) {
+      throw std::length_error("string too long to serialize");
+    }
+    serializer<length>::write(w, static_cast<length>(s.size()));
+    w.write(s.data(), s.size());
+  }
+  static std::string read(reader& r) { return view(r).to_string(); }
+  static string_view view(reader& r) {
+    auto size = serializer<length>::read(r);
+    return string_view(r.read(size), size);
+  }
+};
+
+// Serializes a T through its single data member.
+template <typename T, typename M, M T::*Member>
+struct member_serializer {
+  using view_type = T;
+
+  static void write(writer& w, const T& value) {
+    serializer<M>::write(w, value.*Member);
+  }
+  static T read(reader& r) {
+    T value{};
+    value.*Member = serializer<M>::read(r);
+    return value;
+  }
+  static T view(reader& r) { return read(r); }
+};
+
+// Variants are written as a 16-bit tag followed by the active alternative.
+// A view is a variant of the alternatives' view types, so viewing a
+// variant<std::string, int> yields a variant<string_view, int> without
+// copying the string.
+template <typename... Ts>
+struct serializer<variant<Ts...>> {
+  using view_type = variant<typename serializer<Ts>::view_type...>;
+  using tag_type = std::uint16_t;
+
+  static_assert(sizeof...(Ts) <= std::numeric_limits<tag_type>::max(),
+                "too many alternatives to serialize");
+
+  static void write(writer& w, const variant<Ts...>& v) {
+    serializer<tag_type>::write(w, static_cast<tag_type>(v.tag));
+    v.template visit<void>([&w](const auto& value) {
+      serializer<std::decay_t<decltype(value)>>::write(w, value);
+    });
+  }
+  static variant<Ts...> read(reader& r) {
+    using fn = variant<Ts...> (*)(reader&);
+    static constexpr fn readers[] = {&read_one<Ts>...};
+    return readers[read_tag(r)](r);
+  }
+  static view_type view(reader& r) {
+    using fn = view_type (*)(reader&);
+    static constexpr fn viewers[] = {&view_one<Ts>...};
+    return viewers[read_tag(r)](r);
+  }
+
+ private:
+  static tag_type read_tag(reader& r) {
+    auto tag = serializer<tag_type>::read(r);
+    if (tag >= sizeof...(Ts)) {
+      throw deserialize_error("invalid variant tag " + std::to_string(tag));
+    }
+    return tag;
+  }
+  template <typename T>
+  static variant<Ts...> read_one(reader& r) {
+    return variant<Ts...>(serializer<T>::read(r));
+  }
+  template <typename T>
+  static view_type view_one(reader& r) {
+    return view_type(serializer<T>::view(r));
+  }
+};
+
+template <typename T>
+void serialize(writer& w, const T& value) {
+  serializer<T>::write(w, value);
+}
+
+template <typename T>
+std::string serialize(const T& value) {
+  std::string out;
+  writer w(out);
+  serialize(w, value);
+  return out;
+}
+
+template <typename T>
+T deserialize(reader& r) {
+  return serializer<T>::read(r);
+}
+
+// Reads the next T as a view into the reader's buffer.
+template <typename T>
+typename serializer<T>::view_type deserialize_view(reader& r) {
+  return serializer<T>::view(r);
+}
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef INCLUDED_TOBY_SHARDED_RUNTIME_H
+#define INCLUDED_TOBY_SHARDED_RUNTIME_H
+
+#include "spsc_ring.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace toby {
+
+// Runs a state machine for each of a number of objects, such as robots,
+// with one thread per shard of the objects.  Object i belongs to shard
+// i % shards.  Each producer thread has its own lock-free ring into each
+// shard, so events from one producer to one object are applied in the order
+// they were sent.  Shard threads drain their rings in batches and apply
+// state = transition(state, event) to the target object.  transition must
+// not throw: it runs on a shard thread, where an exception would terminate
+// the process.
+template <typename State, typename Event, typename Transition>
+class sharded_runtime {
+ public:
+  struct message {
+    std::size_t id;
+    Event event;
+
+    template <typename E>
+    message(std::size_t id, E&& event)
+        : id(id), event(std::forward<E>(event)) {}
+  };
+
+  // A handle for sending events from one producer thread.
+  class producer {
+   private:
+    sharded_runtime* m_runtime;
+    std::size_t m_index;
+
+   public:
+    producer(sharded_runtime& runtime, std::size_t index)
+        : m_runtime(&runtime), m_index(index) {}
+
+    // Returns false, leaving event untouched, if the target shard's ring is
+    // full.  Throws std::out_of_range if there is no object id.
+    template <typename E>
+    bool try_send(std::size_t id, E&& event) {
+      if (id >= m_runtime->m_objects) {
+        throw std::out_of_range("sharded_runtime: no object " +
+                                std::to_string(id));
+      }
+      auto& s = *m_runtime->m_shards[id % m_runtime->m_shards.size()];
+      return s.inboxes[m_index]->try_emplace(id, std::forward<E>(event));
+    }
+    // Waits for room in the target shard's ring.
+    template <typename E>
+    void send(std::size_t id, E&& event) {
+      while (!try_send(id, std::forward<E>(event))) {
+        std::this_thread::yield();
+      }
+    }
+  };
+
+ private:
+  struct shard {
+    std::vector<State> states;
+    std::vector<std::unique_ptr<spsc_ring<message>>> inboxes;
+    std::atomic<std::uint64_t> processed{0};
+    std::thread thread;
+  };
+
+  Transition m_transition;
+  std::size_t m_objects;
+  std::size_t m_batch;
+  std::vector<std::unique_ptr<shard>> m_shards;
+  std::atomic<bool> m_stopping{false};
+
+  void run(shard& s) {
+    const auto shards = m_shards.size();
+    std::uint64_t processed = 0;
+    for (;;) {
+      // Read before draining, so that events sent before stop() are applied.
+      bool stopping = m_stopping.load(std::memory_order_acquire);
+      std::size_t n = 0;
+      for (auto& inbox : s.inboxes) {
+        n += inbox->consume(
+            [&](message&& m) {
+              auto& state = s.states[m.id / shards];
+              state = m_transition(state, m.event);
+            },
+            m_batch);
+      }
+      if (n != 0) {
+        processed += n;
+        s.processed.store(processed, std::memory_order_relaxed);
+      } else if (stopping) {
+        return;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  static void pin_to_cpu(std::thread& t, std::size_t cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % CPU_SETSIZE, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#else
+    (void)t;
+    (void)cpu;
+#endif
+  }
+
+ public:
+  // Starts one thread per shard, each pinned to its own core where there are
+  // enough.  Every object starts in initial.
+  sharded_runtime(std::size_t objects, std::size_t shards,
+                  std::size_t producers, const State& initial,
+                  Transition transition = Transition(),
+                  std::size_t ring_capacity = 4096, std::size_t batch = 256)
+      : m_transition(std::move(transition)),
+        m_objects(objects),
+        m_batch(batch) {
+    if (shards == 0 || producers == 0) {
+      throw std::invalid_argument("need at least one shard and producer");
+    }
+    for (std::size_t i = 0; i < shards; ++i) {
+      auto s = std::make_unique<shard>();
+      s->states.assign((objects + shards - 1 - i) / shards, initial);
+      for (std::size_t p = 0; p < producers; ++p) {
+        s->inboxes.push_back(
+            std::make_unique<spsc_ring<message>>(ring_capacity));
+      }
+      m_shards.push_back(std::move(s));
+    }
+    auto cpus = std::thread::hardware_concurrency();
+    try {
+      for (std::size_t i = 0; i < shards; ++i) {
+        auto& s = *m_shards[i];
+        s.thread = std::thread([this, &s] { run(s); });
+        if (shards <= cpus) {
+          pin_to_cpu(s.thread, i);
+        }
+      }
+    } catch (...) {
+      // The destructor will not run, so join the threads already started.
+      stop();
+      throw;
+    }
+  }
+
+  sharded_runtime(const sharded_runtime&) = delete;
+  sharded_runtime& operator=(const sharded_runtime&) = delete;
+
+  ~sharded_runtime() { stop(); }
+
+  // A handle for producer thread index, which must be used by only one
+  // thread at a time.  Throws std::out_of_range if index is not less than
+  // the number of producers.
+  producer make_producer(std::size_t index) {
+    if (index >= m_shards.front()->inboxes.size()) {
+      throw std::out_of_range("sharded_runtime: no producer " +
+                              std::to_string(index));
+    }
+    return producer(*this, index);
+  }
+
+  // Applies every event sent so far and stops the shard threads.
+  void stop() {
+    m_stopping.store(true, std::memory_order_release);
+    for (auto& s : m_shards) {
+      if (s->thread.joinable()) {
+        s->thread.join();
+      }
+    }
+  }
+
+  std::size_t shards() const noexcept { return m_shards.size(); }
+
+  // Number of events applied so far.
+  std::uint64_t processed() const noexcept {
+    std::uint64_t n = 0;
+    for (auto& s : m_shards) {
+      n += s->processed.load(std::memory_order_relaxed);
+    }
+    return n;
+  }
+
+  // The state of object id.  Only call this after stop().
+  const State& state(std::size_t id) const {
+    return m_shards[id % m_shards.size()]->states[id / m_shards.size()];
+  }
+};
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef INCLUDED_TOBY_SHARED_RING_H
+#define INCLUDED_TOBY_SHARED_RING_H
+
+#include "variant.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace toby {
+
+// A read-write shared mapping of a whole POSIX shared memory object or, on
+// Linux, an anonymous memfd that can be handed to another process by
+// inheritance or over a Unix socket.
+class shared_memory {
+ private:
+  int m_fd = -1;
+  char* m_data = nullptr;
+  std::size_t m_size = 0;
+
+  static std::system_error error(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+  }
+
+  // Takes ownership of fd.  A size of 0 maps the whole object.
+  shared_memory(int fd, std::size_t size, const std::string& what) : m_fd(fd) {
+    if (size == 0) {
+      struct stat st;
+      if (::fstat(fd, &st) != 0) {
+        auto e = error("stat " + what);
+        ::close(fd);
+        throw e;
+      }
+      size = static_cast<std::size_t>(st.st_size);
+    } else if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      auto e = error("truncate " + what);
+      ::close(fd);
+      throw e;
+    }
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      auto e = error("mmap " + what);
+      ::close(fd);
+      throw e;
+    }
+    m_data = static_cast<char*>(p);
+    m_size = size;
+  }
+
+ public:
+  // Creates the shared memory object name, which must not exist, with size
+  // zeroed bytes.
+  static shared_memory create(const std::string& name, std::size_t size) {
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+      throw error("shm_open " + name);
+    }
+    return shared_memory(fd, size, name);
+  }
+  static shared_memory open(const std::string& name) {
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+      throw error("shm_open " + name);
+    }
+    return shared_memory(fd, 0, name);
+  }
+  static void unlink(const std::string& name) { ::shm_unlink(name.c_str()); }
+
+#ifdef __linux__
+  // Creates size zeroed bytes of memory that has no name, only fd().
+  static shared_memory create_anonymous(std::size_t size) {
+    int fd = ::memfd_create("toby", MFD_CLOEXEC);
+    if (fd < 0) {
+      throw error("memfd_create");
+    }
+    return shared_memory(fd, size, "memfd");
+  }
+#endif
+  // Maps the object behind fd, which stays owned by the caller.
+  static shared_memory attach(int fd) {
+    int own = ::dup(fd);
+    if (own < 0) {
+      throw error("dup");
+    }
+    return shared_memory(own, 0, "fd " + std::to_string(fd));
+  }
+
+  shared_memory(shared_memory&& other) noexcept
+      : m_fd(std::exchange(other.m_fd, -1)),
+        m_data(std::exchange(other.m_data, nullptr)),
+        m_size(std::exchange(other.m_size, 0)) {}
+  shared_memory& operator=(shared_memory&& other) noexcept {
+    std::swap(m_fd, other.m_fd);
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    return *this;
+  }
+
+  ~shared_memory() {
+    if (m_data) {
+      ::munmap(m_data, m_size);
+    }
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+  }
+
+  int fd() const noexcept { return m_fd; }
+  char* data() const noexcept { return m_data; }
+  std::size_t size() const noexcept { return m_size; }
+};
+
+template <typename Event>
+class shared_ring;
+
+// A bounded lock-free queue of variants in shared memory, for producers and
+// consumers in any number of processes.  The layout holds no pointers: a
+// header with the indexes, then the slots, each with a sequence number, a
+// tag and the storage of an alternative, so every process can map it at a
+// different address.  Alternatives must be trivially copyable; a payload
+// that refers to other shared data must hold an offset into it rather than
+// a pointer.  Producers construct alternatives in their slot and consumers
+// visit them there, so an event is never copied.
+template <typename... Ts>
+class shared_ring<variant<Ts...>> {
+  static_assert(detail::all_of<std::is_trivially_copyable<Ts>::value...>::value,
+                "shared_ring alternatives must be trivially copyable");
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+                "shared_ring needs address-free 64-bit atomics");
+
+ public:
+  using event = variant<Ts...>;
+
+ private:
+  using helper = detail::variant_helper<Ts...>;
+  using super_visit = typename helper::super_visit;
+  using tag_type = typename helper::tag_type;
+  static constexpr std::size_t cache_line = 64;
+  static constexpr std::uint64_t magic = 0x676e6972796274ULL;  // "tbyring"
+
+  struct slot {
+    std::atomic<std::uint64_t> sequence;
+    tag_type tag;
+    std::aligned_union_t<0, char, Ts...> storage;
+  };
+
+  struct header {
+    std::atomic<std::uint64_t> magic;
+    std::uint64_t layout;
+    std::uint64_t capacity;
+    char pad0[cache_line];
+    std::atomic<std::uint64_t> head;
+    char pad1[cache_line];
+    std::atomic<std::uint64_t> tail;
+    char pad2[cache_line];
+  };
+
+  static constexpr std::size_t slots_offset =
+      (sizeof(header) + cache_line - 1) / cache_line * cache_line;
+
+  shared_memory m_memory;
+  header* m_header;
+  slot* m_slots;
+  std::uint64_t m_mask;
+
+  // Identifies the layout of the slots, so that a process built with
+  // different alternatives cannot attach.
+  static constexpr std::uint64_t layout() {
+    const std::uint64_t values[] = {sizeof...(Ts), sizeof(slot),
+                                    alignof(slot), sizeof(Ts)...,
+                                    alignof(Ts)...};
+    std::uint64_t h = 14695981039346656037ULL;
+    for (auto v : values) {
+      h = (h ^ v) * 1099511628211ULL;
+    }
+    return h;
+  }
+
+  explicit shared_ring(shared_memory memory)
+      : m_memory(std::move(memory)),
+        m_header(reinterpret_cast<header*>(m_memory.data())),
+        m_slots(reinterpret_cast<slot*>(m_memory.data() + slots_offset)),
+        m_mask(0) {}
+
+  static shared_ring init(shared_memory memory, std::size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+      throw std::invalid_argument(
+          "shared_ring capacity must be a power of two");
+    }
+    shared_ring ring(std::move(memory));
+    auto h = new (ring.m_header) header;
+    h->layout = layout();
+    h->capacity = capacity;
+    h->head.store(0, std::memory_order_relaxed);
+    h->tail.store(0, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < capacity; ++i) {
+      new (&ring.m_slots[i]) slot;
+      ring.m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    h->magic.store(magic, std::memory_order_release);
+    ring.m_mask = capacity - 1;
+    return ring;
+  }
+
+  static shared_ring attach_to(shared_memory memory) {
+    if (memory.size() < slots_offset) {
+      throw std::runtime_error("shared_ring: memory too small");
+    }
+    shared_ring ring(std::move(memory));
+    auto h = ring.m_header;
+    if (h->magic.load(std::memory_order_acquire) != magic) {
+      throw std::runtime_error("shared_ring: not initialised");
+    }
+    if (h->layout != layout()) {
+      throw std::runtime_error("shared_ring: different alternatives");
+    }
+    // The header may have been written by anything, so check the capacity
+    // without computing a size that could overflow.
+    std::uint64_t capacity = h->capacity;
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+      throw std::runtime_error("shared_ring: corrupt capacity");
+    }
+    if (capacity > (ring.m_memory.size() - slots_offset) / sizeof(slot)) {
+      throw std::runtime_error("shared_ring: memory too small");
+    }
+    ring.m_mask = static_cast<std::size_t>(capacity - 1);
+    return ring;
+  }
+
+  slot* claim(std::uint64_t& pos) {
+    pos = m_header->head.load(std::memory_order_relaxed);
+    for (;;) {
+      auto& s = m_slots[pos & m_mask];
+      auto sequence = s.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::int64_t>(sequence - pos);
+      if (diff == 0) {
+        if (m_header->head.compare_exchange_weak(pos, pos + 1,
+                                                 std::memory_order_relaxed)) {
+          return &s;
+        }
+      } else if (diff < 0) {
+        return nullptr;
+      } else {
+        pos = m_header->head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+ public:
+  static std::size_t bytes_for(std::size_t capacity) {
+    if (capacity > (std::numeric_limits<std::size_t>::max() - slots_offset) /
+                       sizeof(slot)) {
+      throw std::length_error("shared_ring capacity too large");
+    }
+    return slots_offset + capacity * sizeof(slot);
+  }
+
+  // Creates a ring of capacity slots, a power of two, in a new shared
+  // memory object name.
+  static shared_ring create(const std::string& name, std::size_t capacity) {
+    return init(shared_memory::create(name, bytes_for(capacity)), capacity);
+  }
+  // Attaches to the ring in the shared memory object name.
+  static shared_ring open(const std::string& name) {
+    return attach_to(shared_memory::open(name));
+  }
+#ifdef __linux__
+  // Creates a ring in anonymous memory, which other processes reach through
+  // fd().
+  static shared_ring create_anonymous(std::size_t capacity) {
+    return init(shared_memory::create_anonymous(bytes_for(capacity)),
+                capacity);
+  }
+#endif
+  // Attaches to the ring in the memory behind fd.
+  static shared_ring attach(int fd) {
+    return attach_to(shared_memory::attach(fd));
+  }
+
+  int fd() const noexcept { return m_memory.fd(); }
+  std::size_t capacity() const noexcept { return m_mask + 1; }
+
+  // Producer: constructs a T from args in a free slot, or returns false if
+  // the ring is full.
+  template <typename T, typename... Args>
+  bool try_emplace(Args&&... args) {
+    static_assert(detail::is_one_of<T, Ts...>::value,
+                  "T must be an alternative of the variant");
+    std::uint64_t pos;
+    auto s = claim(pos);
+    if (!s) {
+      return false;
+    }
+    new (&s->storage) T(std::forward<Args>(args)...);
+    s->tag = detail::index_of<T, Ts...>::value;
+    s->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+  template <typename T, typename = std::enable_if_t<
+                            detail::is_one_of<std::decay_t<T>, Ts...>::value>>
+  bool try_push(const T& value) {
+    return try_emplace<T>(value);
+  }
+  bool try_push(const event& e) {
+    std::uint64_t pos;
+    auto s = claim(pos);
+    if (!s) {
+      return false;
+    }
+    std::memcpy(&s->storage, &e.storage, sizeof(s->storage));
+    s->tag = e.tag;
+    s->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer: visits up to max published elements from the front in place,
+  // passing each alternative by const reference, and removes them.  Returns
+  // the number consumed.  visitor must not throw.  An element whose tag is
+  // out of range, which another process may have written, is removed
+  // without being visited or counted.
+  template <typename F>
+  std::size_t consume(F&& visitor, std::size_t max) {
+    std::size_t n = 0;
+    auto pos = m_header->tail.load(std::memory_order_relaxed);
+    while (n != max) {
+      auto& s = m_slots[pos & m_mask];
+      if (s.sequence.load(std::memory_order_acquire) != pos + 1) {
+        break;
+      }
+      if (!m_header->tail.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+        continue;
+      }
+      bool valid = s.tag < sizeof...(Ts);
+      if (valid) {
+        super_visit::template visit_helper_const<void>(s.tag, &s.storage,
+                                                       visitor);
+      }
+      s.sequence.store(pos + capacity(), std::memory_order_release);
+      ++pos;
+      n += valid;
+    }
+    return n;
+  }
+
+  // Consumer: copies the front element into e, or returns false if there is
+  // none.
+  bool try_pop(event& e) {
+    return consume([&e](const auto& value) { e = value; }, 1) == 1;
+  }
+};
+
+}  // namespace toby
+
+#endif
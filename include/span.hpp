@@ -0,0 +1,42 @@
+#ifndef INCLUDED_TOBY_SPAN_H
+#define INCLUDED_TOBY_SPAN_H
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+// Just enough of C++20's std::span to pass a run of elements owned by
+// someone else, such as part of a vector.
+template <typename T>
+class span {
+ private:
+  T* m_data = nullptr;
+  std::size_t m_size = 0;
+
+ public:
+  span() noexcept {}
+  span(T* data, std::size_t size) noexcept : m_data(data), m_size(size) {}
+  template <std::size_t N>
+  span(T (&array)[N]) noexcept : m_data(array), m_size(N) {}
+  template <typename Container,
+            typename = std::enable_if_t<std::is_convertible<
+                decltype(std::declval<Container&>().data()), T*>::value>>
+  span(Container& c) noexcept : m_data(c.data()), m_size(c.size()) {}
+
+  T* data() const noexcept { return m_data; }
+  std::size_t size() const noexcept { return m_size; }
+  bool empty() const noexcept { return m_size == 0; }
+  T* begin() const noexcept { return m_data; }
+  T* end() const noexcept { return m_data + m_size; }
+  T& operator[](std::size_t i) const noexcept { return m_data[i]; }
+
+  span subspan(std::size_t offset, std::size_t count) const noexcept {
+    return span(m_data + offset, count);
+  }
+};
+
+}  // namespace toby
+
+#endif
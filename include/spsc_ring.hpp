@@ -0,0 +1,114 @@
+#ifndef INCLUDED_TOBY_SPSC_RING_H
+#define INCLUDED_TOBY_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+// A bounded lock-free queue for exactly one producer thread and one consumer
+// thread.  Each side keeps a cached copy of the other side's index, so it
+// only touches the other side's cache line when the ring looks full or
+// empty, and the consumer publishes its progress once per batch.
+template <typename T>
+class spsc_ring {
+ private:
+  using slot = std::aligned_storage_t<sizeof(T), alignof(T)>;
+  static constexpr std::size_t cache_line = 64;
+
+  std::size_t m_mask;
+  std::unique_ptr<slot[]> m_slots;
+
+  char m_pad0[cache_line];
+  // Written by the producer.
+  std::atomic<std::size_t> m_head{0};
+  std::size_t m_cached_tail = 0;
+  char m_pad1[cache_line];
+  // Written by the consumer.
+  std::atomic<std::size_t> m_tail{0};
+  std::size_t m_cached_head = 0;
+  char m_pad2[cache_line];
+
+  T* at(std::size_t i) { return reinterpret_cast<T*>(&m_slots[i & m_mask]); }
+
+  static std::size_t checked(std::size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+      throw std::invalid_argument("spsc_ring capacity must be a power of two");
+    }
+    return capacity;
+  }
+
+ public:
+  // capacity must be a power of two.
+  explicit spsc_ring(std::size_t capacity)
+      : m_mask(checked(capacity) - 1), m_slots(new slot[capacity]) {}
+
+  spsc_ring(const spsc_ring&) = delete;
+  spsc_ring& operator=(const spsc_ring&) = delete;
+
+  ~spsc_ring() {
+    auto head = m_head.load(std::memory_order_relaxed);
+    for (auto i = m_tail.load(std::memory_order_relaxed); i != head; ++i) {
+      at(i)->~T();
+    }
+  }
+
+  std::size_t capacity() const noexcept { return m_mask + 1; }
+
+  // Producer: constructs an element at the back, or returns false if the
+  // ring is full.
+  template <typename... Args>
+  bool try_emplace(Args&&... args) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head - m_cached_tail == capacity()) {
+      m_cached_tail = m_tail.load(std::memory_order_acquire);
+      if (head - m_cached_tail == capacity()) {
+        return false;
+      }
+    }
+    new (at(head)) T(std::forward<Args>(args)...);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  bool try_push(const T& value) { return try_emplace(value); }
+  bool try_push(T&& value) { return try_emplace(std::move(value)); }
+
+  // Consumer: calls f with up to max elements from the front, as rvalues,
+  // and removes them.  Returns the number consumed.  f must not throw.
+  template <typename F>
+  std::size_t consume(F&& f, std::size_t max) {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if (m_cached_head == tail) {
+      m_cached_head = m_head.load(std::memory_order_acquire);
+      if (m_cached_head == tail) {
+        return 0;
+      }
+    }
+    auto n = m_cached_head - tail;
+    if (n > max) {
+      n = max;
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      auto p = at(tail + i);
+      f(std::move(*p));
+      p->~T();
+    }
+    m_tail.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // Consumer: moves the front element into value, or returns false if the
+  // ring is empty.
+  bool try_pop(T& value) {
+    return consume([&value](T&& v) { value = std::move(v); }, 1) == 1;
+  }
+};
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef INCLUDED_TOBY_STRING_VIEW_H
+#define INCLUDED_TOBY_STRING_VIEW_H
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace toby {
+
+// Just enough of C++17's std::string_view to refer to characters owned by
+// someone else, such as a serialized buffer.
+class string_view {
+ private:
+  const char* m_data = nullptr;
+  std::size_t m_size = 0;
+
+ public:
+  string_view() noexcept {}
+  string_view(const char* data, std::size_t size) noexcept
+      : m_data(data), m_size(size) {}
+  string_view(const char* s) noexcept : m_data(s), m_size(std::strlen(s)) {}
+  string_view(const std::string& s) noexcept
+      : m_data(s.data()), m_size(s.size()) {}
+
+  const char* data() const noexcept { return m_data; }
+  std::size_t size() const noexcept { return m_size; }
+  bool empty() const noexcept { return m_size == 0; }
+  const char* begin() const noexcept { return m_data; }
+  const char* end() const noexcept { return m_data + m_size; }
+  char operator[](std::size_t i) const noexcept { return m_data[i]; }
+
+  std::string to_string() const { return std::string(m_data, m_size); }
+
+  friend bool operator==(string_view a, string_view b) noexcept {
+    return a.m_size == b.m_size &&
+           (a.m_size == 0 || std::memcmp(a.m_data, b.m_data, a.m_size) == 0);
+  }
+  friend bool operator!=(string_view a, string_view b) noexcept {
+    return !(a == b);
+  }
+  friend std::ostream& operator<<(std::ostream& os, string_view s) {
+    return os.write(s.m_data, static_cast<std::streamsize>(s.m_size));
+  }
+};
+
+}  // namespace toby
+
+#endif
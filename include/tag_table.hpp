@@ -0,0 +1,231 @@
+#ifndef INCLUDED_TOBY_TAG_TABLE_H
+#define INCLUDED_TOBY_TAG_TABLE_H
+
+#include "variant.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define TOBY_TAG_TABLE_SSSE3 1
+#else
+#define TOBY_TAG_TABLE_SSSE3 0
+#endif
+
+namespace toby {
+
+// Rule results and patterns for tag_table.
+struct keep {};
+struct any_alternative {};
+
+// A state S receiving an event E moves to R, an empty alternative of the
+// state, or stays as it is if R is keep.  S and E may each be an
+// alternative, a variant of several alternatives or any_alternative.
+template <typename S, typename E, typename R>
+struct tag_rule {};
+
+namespace detail {
+template <typename T, typename Pattern>
+struct matches : std::is_same<T, Pattern> {};
+
+template <typename T>
+struct matches<T, any_alternative> : std::true_type {};
+
+template <typename T, typename... Us>
+struct matches<T, variant<Us...>> : is_one_of<T, Us...> {};
+
+template <typename Pattern, typename... Ts>
+constexpr bool matches_tag(std::size_t tag) {
+  constexpr bool m[] = {matches<Ts, Pattern>::value..., false};
+  return m[tag];
+}
+
+template <typename R, typename... Ss>
+struct rule_result
+    : std::integral_constant<std::uint8_t, index_of<R, Ss...>::value> {
+  static_assert(is_one_of<R, Ss...>::value,
+                "a tag_rule result must be an alternative of the state");
+  static_assert(std::is_empty<R>::value &&
+                    std::is_trivially_default_constructible<R>::value,
+                "a tag_rule result must not have a payload");
+};
+
+template <typename... Ss>
+struct rule_result<keep, Ss...> : std::integral_constant<std::uint8_t, 0xfe> {
+};
+
+template <typename States, typename Events, typename... Rules>
+struct rule_entry;
+
+template <typename States, typename Events>
+struct rule_entry<States, Events> {
+  static constexpr std::uint8_t get(std::size_t, std::size_t) { return 0xff; }
+};
+
+template <typename... Ss, typename... Es, typename S, typename E, typename R,
+          typename... Rules>
+struct rule_entry<type_list<Ss...>, type_list<Es...>, tag_rule<S, E, R>,
+                  Rules...> {
+  static constexpr std::uint8_t get(std::size_t s, std::size_t e) {
+    return matches_tag<S, Ss...>(s) && matches_tag<E, Es...>(e)
+               ? rule_result<R, Ss...>::value
+               : rule_entry<type_list<Ss...>, type_list<Es...>,
+                            Rules...>::get(s, e);
+  }
+};
+
+// The entry of each (state tag, event tag) pair, in state-major order and
+// padded to at least 16 bytes so that it can be loaded into a vector.
+template <typename States, typename Events, typename Rules, typename Indexes>
+struct tag_entries;
+
+template <typename States, typename... Es, typename... Rules,
+          std::size_t... Is>
+struct tag_entries<States, type_list<Es...>, type_list<Rules...>,
+                   std::index_sequence<Is...>> {
+  static constexpr std::size_t size = std::max(sizeof...(Is), std::size_t(16));
+  static constexpr std::uint8_t values[size] = {
+      rule_entry<States, type_list<Es...>, Rules...>::get(
+          Is / sizeof...(Es), Is % sizeof...(Es))...};
+};
+
+template <typename States, typename... Es, typename... Rules,
+          std::size_t... Is>
+constexpr std::uint8_t tag_entries<States, type_list<Es...>,
+                                   type_list<Rules...>,
+                                   std::index_sequence<Is...>>::values[];
+}  // namespace detail
+
+template <typename State, typename Event, typename... Rules>
+class tag_table;
+
+// The transitions of a state machine that depend only on the tags of the
+// state and the event, looked up in a table built at compile time from
+// Rules.  The first rule that matches a pair wins; pairs that no rule
+// matches need the full transition.
+template <typename... Ss, typename... Es, typename... Rules>
+class tag_table<variant<Ss...>, variant<Es...>, Rules...> {
+  using entries = detail::tag_entries<
+      detail::type_list<Ss...>, detail::type_list<Es...>,
+      detail::type_list<Rules...>,
+      std::make_index_sequence<sizeof...(Ss) * sizeof...(Es)>>;
+  using trivial = detail::all_of<std::is_trivially_destructible<Ss>::value...>;
+
+  static constexpr std::size_t event_count = sizeof...(Es);
+  static constexpr std::size_t block = 64;
+
+  using assign_fn = void (*)(variant<Ss...>&);
+
+  template <typename T>
+  static void assign(variant<Ss...>& s) {
+    s = T{};
+  }
+  template <typename T>
+  static constexpr assign_fn assigner(std::true_type) {
+    return &assign<T>;
+  }
+  template <typename T>
+  static constexpr assign_fn assigner(std::false_type) {
+    return nullptr;
+  }
+
+  // Makes s hold the alternative with tag r, which is either its own or an
+  // empty one.  Without destructors to run that is a store of the tag,
+  // which keeps the loop in apply free of branches on the result.
+  static void become(variant<Ss...>& s, std::uint8_t r, std::true_type) {
+    s.tag = r;
+  }
+  static void become(variant<Ss...>& s, std::uint8_t r, std::false_type) {
+    if (r == s.tag) {
+      return;
+    }
+    static constexpr assign_fn assigns[] = {assigner<Ss>(
+        std::integral_constant<bool, std::is_empty<Ss>::value>())...};
+    assigns[r](s);
+  }
+
+ public:
+  // Entries that are not the tag of the new state.
+  static constexpr std::uint8_t unchanged = 0xfe;
+  static constexpr std::uint8_t needs_transition = 0xff;
+
+  static std::uint8_t entry(std::size_t state_tag, std::size_t event_tag) {
+    return entries::values[state_tag * event_count + event_tag];
+  }
+
+  // Sets out[i] to the entry for state_tags[i] and event_tags[i], for each i
+  // below n.
+  static void resolve(const std::uint8_t* state_tags,
+                      const std::uint8_t* event_tags, std::uint8_t* out,
+                      std::size_t n) {
+    std::size_t i = 0;
+#if TOBY_TAG_TABLE_SSSE3
+    if (sizeof...(Ss) * event_count <= 16) {
+      const auto table = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(entries::values));
+      const auto e = static_cast<char>(event_count);
+      // The offset of each state tag's row.
+      const auto rows =
+          _mm_setr_epi8(0, e, 2 * e, 3 * e, 4 * e, 5 * e, 6 * e, 7 * e,
+                        8 * e, 9 * e, 10 * e, 11 * e, 12 * e, 13 * e, 14 * e,
+                        15 * e);
+      for (; i + 16 <= n; i += 16) {
+        auto s = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(state_tags + i));
+        auto ev = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(event_tags + i));
+        auto index = _mm_add_epi8(_mm_shuffle_epi8(rows, s), ev);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_shuffle_epi8(table, index));
+      }
+    }
+#endif
+    for (; i < n; ++i) {
+      out[i] = entry(state_tags[i], event_tags[i]);
+    }
+  }
+
+  // Applies events[i] to states[i] for each i below n.  Pairs whose entry
+  // is a tag or unchanged are applied without visiting; for the others the
+  // state is assigned transition(states[i], events[i]).
+  template <typename Transition>
+  static void apply(variant<Ss...>* states, const variant<Es...>* events,
+                    std::size_t n, Transition&& transition) {
+    std::uint8_t state_tags[block];
+    std::uint8_t event_tags[block];
+    std::uint8_t results[block];
+    for (std::size_t first = 0; first < n; first += block) {
+      const auto count = std::min(block, n - first);
+      auto s = states + first;
+      auto e = events + first;
+      for (std::size_t i = 0; i < count; ++i) {
+        state_tags[i] = s[i].tag;
+        event_tags[i] = e[i].tag;
+      }
+      resolve(state_tags, event_tags, results, count);
+      for (std::size_t i = 0; i < count; ++i) {
+        auto r = results[i];
+        if (r == needs_transition) {
+          s[i] = transition(s[i], e[i]);
+        } else {
+          become(s[i], r == unchanged ? state_tags[i] : r, trivial());
+        }
+      }
+    }
+  }
+};
+
+template <typename... Ss, typename... Es, typename... Rules>
+constexpr std::uint8_t
+    tag_table<variant<Ss...>, variant<Es...>, Rules...>::unchanged;
+template <typename... Ss, typename... Es, typename... Rules>
+constexpr std::uint8_t
+    tag_table<variant<Ss...>, variant<Es...>, Rules...>::needs_transition;
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef INCLUDED_TOBY_TEXT_PARSER_H
+#define INCLUDED_TOBY_TEXT_PARSER_H
+
+#include "charconv.hpp"
+#include "variant.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+class parse_error : public std::runtime_error {
+ private:
+  std::size_t m_line;
+  std::size_t m_parsed;
+  const char* m_resume;
+
+ public:
+  parse_error(std::size_t line, const std::string& what,
+              std::size_t parsed = 0, const char* resume = nullptr)
+      : std::runtime_error("line " + std::to_string(line) + ": " + what),
+        m_line(line),
+        m_parsed(parsed),
+        m_resume(resume) {}
+
+  std::size_t line() const noexcept { return m_line; }
+
+  // Number of values the call that threw had already written, which are
+  // valid.
+  std::size_t parsed() const noexcept { return m_parsed; }
+
+  // Where the input continues after the malformed line, for parsing to
+  // resume from, or nullptr if there is no more input.
+  const char* resume() const noexcept { return m_resume; }
+};
+
+// How a T is written as a line of text: name() is the word that starts the
+// line, and parse(first, last, value) reads the rest of the line into value
+// and returns the end of what it read, or nullptr if it is malformed.
+// Specialise this for each alternative of a variant to be parsed, usually by
+// deriving from no_payload or member_payload.
+template <typename T>
+struct text_format;
+
+// How a value is read from text: numbers as with from_chars, and strings
+// in double quotes, with \" and \\ escapes.
+template <typename T, typename Enable = void>
+struct text_value;
+
+namespace detail {
+inline const char* skip_space(const char* p, const char* last) {
+  while (p != last && (*p == ' ' || *p == '\t')) {
+    ++p;
+  }
+  return p;
+}
+}  // namespace detail
+
+template <typename T>
+struct text_value<T, std::enable_if_t<std::is_arithmetic<T>::value>> {
+  static const char* parse(const char* first, const char* last, T& value) {
+    auto r = from_chars(first, last, value);
+    return r.ec == std::errc() ? r.ptr : nullptr;
+  }
+};
+
+template <>
+struct text_value<std::string> {
+  static const char* parse(const char* first, const char* last,
+                           std::string& value) {
+    if (first == last || *first != '"') {
+      return nullptr;
+    }
+    value.clear();
+    const char* run = ++first;
+    for (const char* p = first; p != last; ++p) {
+      if (*p == '"') {
+        value.append(run, p);
+        return p + 1;
+      } else if (*p == '\\') {
+        value.append(run, p);
+        if (++p == last) {
+          return nullptr;
+        }
+        run = p;
+      }
+    }
+    return nullptr;
+  }
+};
+
+// A text_format base for alternatives written as just their name.
+template <typename T>
+struct no_payload {
+  static const char* parse(const char* first, const char*, T&) {
+    return first;
+  }
+};
+
+// A text_format base for alternatives written as their name followed by the
+// value of their one data member.
+template <typename T, typename M, M T::*Member>
+struct member_payload {
+  static const char* parse(const char* first, const char* last, T& value) {
+    auto p = detail::skip_space(first, last);
+    if (p == first) {
+      return nullptr;
+    }
+    return text_value<M>::parse(p, last, value.*Member);
+  }
+};
+
+namespace detail {
+constexpr std::size_t length(const char* s) {
+  std::size_t n = 0;
+  while (s[n]) {
+    ++n;
+  }
+  return n;
+}
+
+// FNV-1a, with the seed mixed into the offset basis.
+constexpr std::uint32_t name_hash(const char* first, const char* last,
+                                  std::uint32_t seed) {
+  std::uint32_t h = 2166136261u ^ seed;
+  for (; first != last; ++first) {
+    h ^= static_cast<unsigned char>(*first);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// The smallest power of two at least twice n.
+constexpr std::size_t name_table_size(std::size_t n) {
+  std::size_t size = 1;
+  while (size < 2 * n) {
+    size *= 2;
+  }
+  return size;
+}
+
+// A perfect hash of a set of names: each name hashes with seed to its own
+// slot, which holds its index plus one.  Empty slots hold 0.
+template <std::size_t Size>
+struct name_table {
+  std::uint32_t seed;
+  std::uint8_t slots[Size];
+};
+
+template <std::size_t Size, std::size_t N>
+constexpr name_table<Size> make_name_table(const char* const (&names)[N]) {
+  static_assert(N < 256, "too many names");
+  for (std::uint32_t seed = 0;; ++seed) {
+    name_table<Size> table{seed, {}};
+    bool distinct = true;
+    for (std::size_t i = 0; i < N && distinct; ++i) {
+      auto slot =
+          name_hash(names[i], names[i] + length(names[i]), seed) % Size;
+      distinct = table.slots[slot] == 0;
+      table.slots[slot] = static_cast<std::uint8_t>(i + 1);
+    }
+    if (distinct) {
+      return table;
+    }
+  }
+}
+}  // namespace detail
+
+template <typename V>
+class text_parser;
+
+// Parses lines of text such as "start_turning 42" or "reset \"reason\"" into
+// a variant<Ts...>, where each line names one alternative.  Names are looked
+// up in a perfect hash table built at compile time from the alternatives'
+// text_formats.  Input may arrive in chunks of any size; nothing is
+// allocated per line except the alternatives' own payloads, such as strings.
+template <typename... Ts>
+class text_parser<variant<Ts...>> {
+ public:
+  using value_type = variant<Ts...>;
+
+  struct result {
+    std::size_t count;
+    const char* ptr;
+  };
+
+ private:
+  static constexpr std::size_t table_size =
+      detail::name_table_size(sizeof...(Ts));
+
+  std::string m_partial;
+  std::size_t m_line = 0;
+
+  // The index of the alternative named by [first, last), or sizeof...(Ts).
+  static std::size_t lookup(const char* first, const char* last) {
+    static constexpr const char* names[] = {text_format<Ts>::name()...};
+    static constexpr std::size_t lengths[] = {
+        detail::length(text_format<Ts>::name())...};
+    static constexpr auto table =
+        detail::make_name_table<table_size>(names);
+    auto i = table.slots[detail::name_hash(first, last, table.seed) %
+                         table_size];
+    auto size = static_cast<std::size_t>(last - first);
+    if (i == 0 || size != lengths[i - 1] ||
+        std::memcmp(first, names[i - 1], size) != 0) {
+      return sizeof...(Ts);
+    }
+    return i - 1;
+  }
+
+  template <typename T>
+  static const char* parse_one(const char* first, const char* last,
+                               value_type& out) {
+    T value{};
+    auto p = text_format<T>::parse(first, last, value);
+    if (p) {
+      out = std::move(value);
+    }
+    return p;
+  }
+
+  // Parses one line, without its newline, into out.  Returns false if the
+  // line is blank.  parsed is the number of values written before it, and
+  // resume where the input continues after it.
+  bool parse_line(const char* first, const char* last, value_type& out,
+                  std::size_t parsed, const char* resume) {
+    ++m_line;
+    first = detail::skip_space(first, last);
+    while (last != first &&
+           (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r')) {
+      --last;
+    }
+    if (first == last) {
+      return false;
+    }
+    auto name_end = first;
+    while (name_end != last && *name_end != ' ' && *name_end != '\t') {
+      ++name_end;
+    }
+    auto tag = lookup(first, name_end);
+    if (tag == sizeof...(Ts)) {
+      throw parse_error(m_line, "unknown name " + std::string(first, name_end),
+                        parsed, resume);
+    }
+    using fn = const char* (*)(const char*, const char*, value_type&);
+    static constexpr fn parsers[] = {&parse_one<Ts>...};
+    auto p = parsers[tag](name_end, last, out);
+    if (!p || p != last) {
+      throw parse_error(m_line, "malformed " + std::string(first, name_end),
+                        parsed, resume);
+    }
+    return true;
+  }
+
+ public:
+  // Parses the lines in [first, last) into out, stopping early once capacity
+  // values have been written.  Returns the number written and where parsing
+  // stopped; if that is before last, call again from there.  A line cut off
+  // by the end of the input is kept and completed by the next call.  Blank
+  // lines are skipped.  Throws parse_error if a line is malformed; the next
+  // call starts afresh at the start of a line, such as the error's resume().
+  result parse(const char* first, const char* last, value_type* out,
+               std::size_t capacity) {
+    std::size_t n = 0;
+    const char* p = first;
+    if (!m_partial.empty() && capacity > 0) {
+      auto nl = static_cast<const char*>(std::memchr(p, '\n', last - p));
+      if (!nl) {
+        m_partial.append(p, last);
+        return {0, last};
+      }
+      m_partial.append(p, nl);
+      p = nl + 1;
+      bool parsed;
+      try {
+        parsed = parse_line(m_partial.data(),
+                            m_partial.data() + m_partial.size(), out[n], n, p);
+      } catch (...) {
+        m_partial.clear();
+        throw;
+      }
+      m_partial.clear();
+      n += parsed;
+    }
+    while (n < capacity && p != last) {
+      auto nl = static_cast<const char*>(std::memchr(p, '\n', last - p));
+      if (!nl) {
+        m_partial.assign(p, last);
+        return {n, last};
+      }
+      if (parse_line(p, nl, out[n], n, nl + 1)) {
+        ++n;
+      }
+      p = nl + 1;
+    }
+    return {n, p};
+  }
+
+  // Parses a final line that had no newline at the end of the input.
+  // Returns whether it wrote a value to out.
+  bool finish(value_type& out) {
+    if (m_partial.empty()) {
+      return false;
+    }
+    std::string line;
+    line.swap(m_partial);
+    return parse_line(line.data(), line.data() + line.size(), out, 0,
+                      nullptr);
+  }
+
+  // Number of lines parsed so far.
+  std::size_t line() const noexcept { return m_line; }
+};
+
+}  // namespace toby
+
+#endif
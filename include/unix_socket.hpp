@@ -0,0 +1,227 @@
+#ifndef INCLUDED_TOBY_UNIX_SOCKET_H
+#define INCLUDED_TOBY_UNIX_SOCKET_H
+
+#include "string_view.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace toby {
+
+// The address of the Unix socket at path.
+inline sockaddr_un unix_address(const std::string& path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw std::system_error(ENAMETOOLONG, std::generic_category(), path);
+  }
+  std::memcpy(addr.sun_path, path.data(), path.size());
+  return addr;
+}
+
+// Buffers for up to capacity datagrams of up to max_size bytes each, filled
+// by unix_datagram_socket::receive with one system call where recvmmsg is
+// available.
+class datagram_batch {
+ private:
+  friend class unix_datagram_socket;
+
+  std::size_t m_max_size;
+  std::vector<char> m_buffers;
+  std::vector<sockaddr_un> m_from;
+#ifdef __linux__
+  std::vector<iovec> m_iovecs;
+  std::vector<mmsghdr> m_headers;
+#endif
+  std::vector<std::size_t> m_sizes;
+  std::vector<socklen_t> m_from_sizes;
+  std::size_t m_count = 0;
+
+ public:
+  explicit datagram_batch(std::size_t capacity, std::size_t max_size = 4096)
+      : m_max_size(max_size),
+        m_buffers(capacity * max_size),
+        m_from(capacity),
+#ifdef __linux__
+        m_iovecs(capacity),
+        m_headers(capacity),
+#endif
+        m_sizes(capacity),
+        m_from_sizes(capacity) {
+#ifdef __linux__
+    for (std::size_t i = 0; i < capacity; ++i) {
+      m_iovecs[i].iov_base = &m_buffers[i * max_size];
+      m_iovecs[i].iov_len = max_size;
+    }
+#endif
+  }
+
+  std::size_t capacity() const noexcept { return m_from.size(); }
+  // Number of datagrams received by the last receive().
+  std::size_t size() const noexcept { return m_count; }
+
+  string_view data(std::size_t i) const {
+    return string_view(&m_buffers[i * m_max_size], m_sizes[i]);
+  }
+  const sockaddr_un& from(std::size_t i) const { return m_from[i]; }
+  socklen_t from_size(std::size_t i) const { return m_from_sizes[i]; }
+};
+
+// An AF_UNIX SOCK_DGRAM socket.  Unix datagrams are neither lost nor
+// reordered, and a sender blocks while the receiver's queue is full.
+class unix_datagram_socket {
+ private:
+  int m_fd = -1;
+
+  static std::system_error error(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+  }
+
+  explicit unix_datagram_socket(int fd) noexcept : m_fd(fd) {}
+
+ public:
+  unix_datagram_socket() : m_fd(::socket(AF_UNIX, SOCK_DGRAM, 0)) {
+    if (m_fd < 0) {
+      throw error("socket");
+    }
+  }
+
+  // Two sockets connected to each other.
+  static std::pair<unix_datagram_socket, unix_datagram_socket> pair() {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0) {
+      throw error("socketpair");
+    }
+    return {unix_datagram_socket(fds[0]), unix_datagram_socket(fds[1])};
+  }
+
+  unix_datagram_socket(unix_datagram_socket&& other) noexcept
+      : m_fd(std::exchange(other.m_fd, -1)) {}
+  unix_datagram_socket& operator=(unix_datagram_socket&& other) noexcept {
+    std::swap(m_fd, other.m_fd);
+    return *this;
+  }
+
+  ~unix_datagram_socket() {
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+  }
+
+  int fd() const noexcept { return m_fd; }
+
+  void bind(const std::string& path) {
+    auto addr = unix_address(path);
+    if (::bind(m_fd, reinterpret_cast<const sockaddr*>(&addr),
+               sizeof(addr)) != 0) {
+      throw error("bind " + path);
+    }
+  }
+  void connect(const std::string& path) {
+    auto addr = unix_address(path);
+    if (::connect(m_fd, reinterpret_cast<const sockaddr*>(&addr),
+                  sizeof(addr)) != 0) {
+      throw error("connect " + path);
+    }
+  }
+
+  // Makes receive() give up after timeout without a datagram.
+  void set_receive_timeout(std::chrono::microseconds timeout) {
+    timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+    tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000000);
+    if (::setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0) {
+      throw error("setsockopt");
+    }
+  }
+
+  void send(const void* data, std::size_t size) {
+    if (::send(m_fd, data, size, 0) < 0) {
+      throw error("send");
+    }
+  }
+  void send_to(const sockaddr_un& addr, socklen_t addr_size,
+               const void* data, std::size_t size) {
+    if (::sendto(m_fd, data, size, 0,
+                 reinterpret_cast<const sockaddr*>(&addr), addr_size) < 0) {
+      throw error("sendto");
+    }
+  }
+  // Like send_to, but returns false instead of blocking when the receiver's
+  // queue is full.
+  bool try_send_to(const sockaddr_un& addr, socklen_t addr_size,
+                   const void* data, std::size_t size) {
+    if (::sendto(m_fd, data, size, MSG_DONTWAIT,
+                 reinterpret_cast<const sockaddr*>(&addr), addr_size) < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return false;
+      }
+      throw error("sendto");
+    }
+    return true;
+  }
+
+  // Waits for at least one datagram and fills batch with as many as are
+  // queued, up to its capacity.  Returns the number received, which is 0 if
+  // the receive timeout expired or a signal arrived first.
+  std::size_t receive(datagram_batch& batch) {
+    batch.m_count = 0;
+#ifdef __linux__
+    const auto capacity = batch.capacity();
+    for (std::size_t i = 0; i < capacity; ++i) {
+      auto& h = batch.m_headers[i].msg_hdr;
+      std::memset(&h, 0, sizeof(h));
+      h.msg_name = &batch.m_from[i];
+      h.msg_namelen = sizeof(sockaddr_un);
+      h.msg_iov = &batch.m_iovecs[i];
+      h.msg_iovlen = 1;
+    }
+    int n = ::recvmmsg(m_fd, batch.m_headers.data(),
+                       static_cast<unsigned>(capacity), MSG_WAITFORONE,
+                       nullptr);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+      }
+      throw error("recvmmsg");
+    }
+    for (int i = 0; i < n; ++i) {
+      batch.m_sizes[i] = batch.m_headers[i].msg_len;
+      batch.m_from_sizes[i] = batch.m_headers[i].msg_hdr.msg_namelen;
+    }
+    batch.m_count = static_cast<std::size_t>(n);
+#else
+    // One datagram per call where recvmmsg is missing.
+    socklen_t from_size = sizeof(sockaddr_un);
+    auto n = ::recvfrom(m_fd, &batch.m_buffers[0], batch.m_max_size, 0,
+                        reinterpret_cast<sockaddr*>(&batch.m_from[0]),
+                        &from_size);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+      }
+      throw error("recvfrom");
+    }
+    batch.m_sizes[0] = static_cast<std::size_t>(n);
+    batch.m_from_sizes[0] = from_size;
+    batch.m_count = 1;
+#endif
+    return batch.m_count;
+  }
+};
+
+}  // namespace toby
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef INCLUDED_TOBY_UPDATER_H
+#define INCLUDED_TOBY_UPDATER_H
+
+#include "multivisitor.hpp"
+#include "overload_set.hpp"
+#include "variant.hpp"
+
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+
+// Returned by an updater handler to leave the state as it is, apart from
+// any changes the handler made to it through its reference.
+struct unchanged {};
+
+namespace detail {
+template <typename... Ss>
+void apply_update(variant<Ss...>&, unchanged) {}
+
+// Replacing an alternative with one of the same type assigns the payload;
+// replacing it with another destroys it and constructs the new one.
+template <typename... Ss, typename T,
+          typename = std::enable_if_t<is_one_of<std::decay_t<T>, Ss...>::value>>
+void apply_update(variant<Ss...>& s, T&& value) {
+  using U = std::decay_t<T>;
+  if (s.tag == index_of<U, Ss...>::value) {
+    *reinterpret_cast<U*>(&s.storage) = std::forward<T>(value);
+  } else {
+    s = std::forward<T>(value);
+  }
+}
+
+// A handler that may do one of several things returns a variant of them,
+// such as variant<unchanged, idle>.
+template <typename... Ss, typename... Us>
+void apply_update(variant<Ss...>& s, variant<Us...>&& result) {
+  std::move(result).template visit<void>([&s](auto&& r) {
+    apply_update(s, std::forward<decltype(r)>(r));
+  });
+}
+}  // namespace detail
+
+// Like multivisitor, but the first argument is a variant that is updated in
+// place.  The handler gets its active alternative by non-const reference
+// and the active alternatives of the other arguments by const reference,
+// and returns unchanged, a new alternative, or a variant of those.  The
+// state is only assigned when the handler returns a new alternative, so
+// handlers that change nothing, or that change the payload through the
+// reference, cost no special member calls.
+template <typename F>
+class updater {
+ private:
+  F m_f;
+
+ public:
+  explicit updater(F&& f) : m_f(std::forward<F>(f)) {}
+
+  template <typename... Ss, typename... Vs>
+  void operator()(variant<Ss...>& s, const Vs&... args) {
+    // Visiting the rvalue passes a reference to the alternative in place,
+    // without moving from it.
+    std::move(s).template visit<void>([&](auto&& current) {
+      make_multivisitor<void>([&](const auto&... others) {
+        detail::apply_update(s, m_f(current, others...));
+      })(args...);
+    });
+  }
+};
+
+template <typename F>
+auto make_updater(F&& f) {
+  return updater<F>(std::forward<F>(f));
+}
+
+template <typename... Fs>
+auto make_updater(Fs&&... fs) {
+  return make_updater(make_overload_set(std::forward<Fs>(fs)...));
+}
+
+}  // namespace toby
+
+#endif
@@ -1,16 +1,34 @@
 #ifndef INCLUDED_TOBY_VARIANT_H
 #define INCLUDED_TOBY_VARIANT_H
 
+#include "optional.hpp"
 #include "overload_set.hpp"
+#include "relocate.hpp"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
 #include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include <spdlog/sinks/null_sink.h>
 #include <spdlog/spdlog.h>
 
+#ifndef TOBY_VARIANT_LOGGING
+#define TOBY_VARIANT_LOGGING 1
+#endif
+
 namespace toby {
 namespace detail {
+// logger() may allocate and throw, so members that log are never noexcept.
+constexpr bool logging_enabled = TOBY_VARIANT_LOGGING;
+
 inline auto logger() {
   auto l = spdlog::get("variant");
   if (l) {
@@ -33,19 +51,26 @@ struct variant_construct<I, N, T, Ts...>
     : private variant_construct<I, N + 1, Ts...> {
   using super = variant_construct<I, N + 1, Ts...>;
 
-  static I construct(void* storage, const T& value) {
-    logger()->debug() << "copy construct<" << N << ">";
+  static I construct(void* storage, const T& value) noexcept(
+      !logging_enabled && std::is_nothrow_copy_constructible<T>::value) {
+    if (logging_enabled) logger()->debug() << "copy construct<" << N << ">";
     new (storage) T(value);
     return N;
   }
-  static I construct(void* storage, T&& value) {
-    logger()->debug() << "move construct<" << N << ">";
+  static I construct(void* storage, T&& value) noexcept(
+      !logging_enabled && std::is_nothrow_move_constructible<T>::value) {
+    if (logging_enabled) logger()->debug() << "move construct<" << N << ">";
     new (storage) T(std::forward<T>(value));
     return N;
   }
   using super::construct;
 };
 
+template <typename I>
+[[noreturn]] void invalid_tag(I tag) {
+  throw std::logic_error("variant tag invalid: " + std::to_string(tag));
+}
+
 template <typename I, I N, typename... Ts>
 struct variant_visit;
 
@@ -53,11 +78,11 @@ template <typename I, I N>
 struct variant_visit<I, N> {
   template <typename R, typename F>
   static R visit_helper_const(I tag, const void*, F&&) {
-    throw std::logic_error("variant tag invalid: " + std::to_string(tag));
+    invalid_tag(tag);
   }
   template <typename R, typename F>
   static R visit_helper_rvalue(I tag, void*, F&&) {
-    throw std::logic_error("variant tag invalid: " + std::to_string(tag));
+    invalid_tag(tag);
   }
 };
 
@@ -67,7 +92,9 @@ struct variant_visit<I, N, T, Ts...> : private variant_visit<I, N + 1, Ts...> {
 
   template <typename R, typename F>
   static R visit_helper_const(I tag, const void* storage, F&& f) {
-    logger()->debug() << "visit_helper<" << N << "> const& (" << tag << ")";
+    if (logging_enabled) {
+      logger()->debug() << "visit_helper<" << N << "> const& (" << tag << ")";
+    }
     if (tag == N) {
       return f(*reinterpret_cast<const T*>(storage));
     }
@@ -76,7 +103,9 @@ struct variant_visit<I, N, T, Ts...> : private variant_visit<I, N + 1, Ts...> {
   }
   template <typename R, typename F>
   static R visit_helper_rvalue(I tag, void* storage, F&& f) {
-    logger()->debug() << "visit_helper<" << N << "> && (" << tag << ")";
+    if (logging_enabled) {
+      logger()->debug() << "visit_helper<" << N << "> && (" << tag << ")";
+    }
     if (tag == N) {
       return f(std::move(*reinterpret_cast<T*>(storage)));
     }
@@ -85,6 +114,148 @@ struct variant_visit<I, N, T, Ts...> : private variant_visit<I, N + 1, Ts...> {
   }
 };
 
+// The recursive variant_visit above compiles to a chain of comparisons and
+// calls that compilers are reluctant to flatten.  For up to 64 alternatives we
+// instead expand a real switch over the tag, padded out to the next bucket
+// size, so that each case is a direct call the visitor can be inlined into.
+template <bool Valid, std::size_t N, typename... Ts>
+struct variant_case {
+  template <typename R, typename F>
+  static R visit_helper_const(const void*, F&&) {
+    invalid_tag(N);
+  }
+  template <typename R, typename F>
+  static R visit_helper_rvalue(void*, F&&) {
+    invalid_tag(N);
+  }
+};
+
+template <std::size_t N, typename... Ts>
+struct variant_case<true, N, Ts...> {
+  using T = std::tuple_element_t<N, std::tuple<Ts...>>;
+
+  template <typename R, typename F>
+  static R visit_helper_const(const void* storage, F&& f) {
+    return f(*reinterpret_cast<const T*>(storage));
+  }
+  template <typename R, typename F>
+  static R visit_helper_rvalue(void* storage, F&& f) {
+    return f(std::move(*reinterpret_cast<T*>(storage)));
+  }
+};
+
+constexpr std::size_t variant_switch_cases(std::size_t n) {
+  return n <= 4 ? 4 : n <= 8 ? 8 : n <= 16 ? 16 : n <= 32 ? 32 : n <= 64 ? 64
+                                                                          : 0;
+}
+
+template <std::size_t Cases, typename I, typename... Ts>
+struct variant_switch;
+
+// More than 64 alternatives: fall back to the recursive dispatch.
+template <typename I, typename... Ts>
+struct variant_switch<0, I, Ts...> : variant_visit<I, 0, Ts...> {};
+
+#define TOBY_VARIANT_CASE(N, HELPER)                                       \
+  case (N):                                                                \
+    if ((N) < sizeof...(Ts)) {                                             \
+      return variant_case<((N) < sizeof...(Ts)), (N),                      \
+                          Ts...>::template HELPER<R>(storage,              \
+                                                     std::forward<F>(f));  \
+    }                                                                      \
+    break;
+#define TOBY_VARIANT_CASES_4(B, HELPER)                                    \
+  TOBY_VARIANT_CASE((B) + 0, HELPER)                                       \
+  TOBY_VARIANT_CASE((B) + 1, HELPER)                                       \
+  TOBY_VARIANT_CASE((B) + 2, HELPER)                                       \
+  TOBY_VARIANT_CASE((B) + 3, HELPER)
+#define TOBY_VARIANT_CASES_8(B, HELPER)                                    \
+  TOBY_VARIANT_CASES_4(B, HELPER) TOBY_VARIANT_CASES_4((B) + 4, HELPER)
+#define TOBY_VARIANT_CASES_16(B, HELPER)                                   \
+  TOBY_VARIANT_CASES_8(B, HELPER) TOBY_VARIANT_CASES_8((B) + 8, HELPER)
+#define TOBY_VARIANT_CASES_32(B, HELPER)                                   \
+  TOBY_VARIANT_CASES_16(B, HELPER) TOBY_VARIANT_CASES_16((B) + 16, HELPER)
+#define TOBY_VARIANT_CASES_64(B, HELPER)                                   \
+  TOBY_VARIANT_CASES_32(B, HELPER) TOBY_VARIANT_CASES_32((B) + 32, HELPER)
+
+#define TOBY_VARIANT_SWITCH(CASES)                                         \
+  template <typename I, typename... Ts>                                    \
+  struct variant_switch<CASES, I, Ts...> {                                 \
+    template <typename R, typename F>                                      \
+    static R visit_helper_const(I tag, const void* storage, F&& f) {       \
+      switch (tag) { TOBY_VARIANT_CASES_##CASES(0, visit_helper_const) }  \
+      invalid_tag(tag);                                                    \
+    }                                                                      \
+    template <typename R, typename F>                                      \
+    static R visit_helper_rvalue(I tag, void* storage, F&& f) {            \
+      switch (tag) { TOBY_VARIANT_CASES_##CASES(0, visit_helper_rvalue) } \
+      invalid_tag(tag);                                                    \
+    }                                                                      \
+  };
+
+TOBY_VARIANT_SWITCH(4)
+TOBY_VARIANT_SWITCH(8)
+TOBY_VARIANT_SWITCH(16)
+TOBY_VARIANT_SWITCH(32)
+TOBY_VARIANT_SWITCH(64)
+
+#undef TOBY_VARIANT_SWITCH
+#undef TOBY_VARIANT_CASES_64
+#undef TOBY_VARIANT_CASES_32
+#undef TOBY_VARIANT_CASES_16
+#undef TOBY_VARIANT_CASES_8
+#undef TOBY_VARIANT_CASES_4
+#undef TOBY_VARIANT_CASE
+
+template <bool... Bs>
+struct bool_pack;
+
+template <bool... Bs>
+using all_of = std::is_same<bool_pack<true, Bs...>, bool_pack<Bs..., true>>;
+
+// Index of T in Ts, or sizeof...(Ts) if T is not one of Ts.
+template <typename T, typename... Ts>
+struct index_of;
+
+template <typename T>
+struct index_of<T> : std::integral_constant<std::size_t, 0> {};
+
+template <typename T, typename... Ts>
+struct index_of<T, T, Ts...> : std::integral_constant<std::size_t, 0> {};
+
+template <typename T, typename U, typename... Ts>
+struct index_of<T, U, Ts...>
+    : std::integral_constant<std::size_t, 1 + index_of<T, Ts...>::value> {};
+
+template <typename T, typename... Ts>
+using is_one_of =
+    std::integral_constant<bool, (index_of<T, Ts...>::value < sizeof...(Ts))>;
+
+template <typename... Ts>
+struct type_list;
+
+template <typename List, typename... Ts>
+struct is_subset;
+
+template <typename... Us, typename... Ts>
+struct is_subset<type_list<Us...>, Ts...>
+    : all_of<is_one_of<Us, Ts...>::value...> {};
+
+// Maps the index of an alternative in Us to its index in Ts, or to
+// sizeof...(Ts) if it is not one of Ts.  A tag out of range for Us also
+// maps to sizeof...(Ts), an invalid tag, so visiting the result throws.
+template <typename I, typename... Ts>
+struct tag_remap {
+  template <typename... Us>
+  static I from(std::size_t tag) {
+    static constexpr I tags[] = {static_cast<I>(index_of<Us, Ts...>::value)...,
+                                 static_cast<I>(sizeof...(Ts))};
+    return tags[std::min(tag, sizeof...(Us))];
+  }
+};
+
+struct convert_t {};
+
 template <uintmax_t N, typename Enable = void>
 struct smallest_unisnged_type;
 
@@ -101,10 +272,72 @@ template <typename... Ts>
 struct variant_helper {
   using tag_type = smallest_unisnged_type_t<sizeof...(Ts)>;
   using super_construct = variant_construct<tag_type, 0, Ts...>;
-  using super_visit = variant_visit<tag_type, 0, Ts...>;
+  using super_visit =
+      variant_switch<variant_switch_cases(sizeof...(Ts)), tag_type, Ts...>;
 };
 }
 
+template <typename... Ts>
+class variant;
+
+template <typename... Ts>
+class variant_view;
+
+template <typename... Ts>
+class packed_variant_stream;
+
+template <typename... Ts>
+struct is_variant : std::false_type {};
+
+template <typename... Ts>
+struct is_variant<variant<Ts...>> : std::true_type {};
+
+namespace detail {
+
+template <typename List, typename T>
+struct append_unique;
+
+template <typename... Ts, typename T>
+struct append_unique<type_list<Ts...>, T>
+    : std::conditional<is_one_of<T, Ts...>::value, type_list<Ts...>,
+                       type_list<Ts..., T>> {};
+
+// Appends the alternatives of Ts to List, replacing each nested variant with
+// its own alternatives and dropping duplicates.
+template <typename List, typename... Ts>
+struct flatten_into {
+  using type = List;
+};
+
+template <typename List, typename T, typename... Ts>
+struct flatten_into<List, T, Ts...>
+    : flatten_into<typename append_unique<List, T>::type, Ts...> {};
+
+template <typename List, typename... Us, typename... Ts>
+struct flatten_into<List, variant<Us...>, Ts...>
+    : flatten_into<typename flatten_into<List, Us...>::type, Ts...> {};
+
+template <typename List>
+struct variant_of;
+
+template <typename... Ts>
+struct variant_of<type_list<Ts...>> {
+  using type = variant<Ts...>;
+};
+
+}  // namespace detail
+
+// The variant with the alternatives of V, where each alternative that is
+// itself a variant is replaced with its alternatives, recursively:
+// flatten_t<variant<variant<A, B>, C>> is variant<A, B, C>.
+template <typename V>
+using flatten_t = typename detail::variant_of<
+    typename detail::flatten_into<detail::type_list<>, V>::type>::type;
+
+template <typename... Ts>
+struct is_trivially_relocatable<variant<Ts...>>
+    : detail::all_trivially_relocatable<Ts...> {};
+
 template <typename... Ts>
 class variant : private detail::variant_helper<Ts...>::super_construct,
                 private detail::variant_helper<Ts...>::super_visit {
@@ -112,13 +345,36 @@ class variant : private detail::variant_helper<Ts...>::super_construct,
   using super_construct = typename helper::super_construct;
   using super_visit = typename helper::super_visit;
 
+  using nothrow_copy =
+      detail::all_of<!detail::logging_enabled,
+                     std::is_nothrow_copy_constructible<Ts>::value...>;
+  using nothrow_move =
+      detail::all_of<!detail::logging_enabled,
+                     std::is_nothrow_move_constructible<Ts>::value...>;
+  using nothrow_destroy =
+      detail::all_of<std::is_nothrow_destructible<Ts>::value...>;
+
  public:
+  using view = variant_view<Ts...>;
+
   typename std::aligned_union_t<0, char, Ts...> storage;
   typename helper::tag_type tag;
 
  private:
   using super_construct::construct;
 
+  // Empty alternatives write no bytes, so zero the storage for them.  Then
+  // the compiler can see that the other cases of a visit, which it cannot
+  // always rule out, never read uninitialised memory.
+  template <typename T>
+  void construct_value(T&& value) noexcept(
+      noexcept(construct(&storage, std::forward<T>(value)))) {
+    if (std::is_empty<std::decay_t<T>>::value) {
+      std::memset(&storage, 0, sizeof(storage));
+    }
+    tag = construct(&storage, std::forward<T>(value));
+  }
+
   void destruct() {
     std::move(*this).template visit<void>([this](auto&& v) {
       using T = std::decay_t<decltype(v)>;
@@ -126,60 +382,231 @@ class variant : private detail::variant_helper<Ts...>::super_construct,
     });
   }
 
+  template <typename... Us>
+  using widens_from = std::integral_constant<
+      bool, detail::is_subset<detail::type_list<Us...>, Ts...>::value &&
+                !std::is_same<variant<Us...>, variant>::value &&
+                !detail::is_one_of<variant<Us...>, Ts...>::value>;
+
+  template <typename... Us>
+  using trivially_converts_from =
+      detail::all_of<std::is_trivially_copyable<Us>::value...>;
+
+  template <typename... Us>
+  void convert_from(const variant<Us...>& other, std::true_type) noexcept {
+    constexpr std::size_t n = sizeof(storage) < sizeof(other.storage)
+                                  ? sizeof(storage)
+                                  : sizeof(other.storage);
+    std::memcpy(&storage, &other.storage, n);
+  }
+  template <typename V>
+  void convert_from(V&& other, std::false_type) {
+    std::forward<V>(other).template visit<void>([this](auto&& value) {
+      using T = std::decay_t<decltype(value)>;
+      this->convert_one(std::forward<decltype(value)>(value),
+                        detail::is_one_of<T, Ts...>());
+    });
+  }
+
+  template <typename... Us>
+  using flattens_from = std::integral_constant<
+      bool, !detail::is_subset<detail::type_list<Us...>, Ts...>::value &&
+                detail::is_subset<typename detail::flatten_into<
+                                      detail::type_list<>, Us...>::type,
+                                  Ts...>::value &&
+                !detail::is_one_of<variant<Us...>, Ts...>::value>;
+
+  template <typename V>
+  void flatten_from(V&& other) {
+    std::forward<V>(other).template visit<void>([this](auto&& value) {
+      using T = std::decay_t<decltype(value)>;
+      this->flatten_one(std::forward<decltype(value)>(value), is_variant<T>());
+    });
+  }
+  template <typename T>
+  void flatten_one(T&& value, std::false_type) {
+    this->construct_value(std::forward<T>(value));
+  }
+  template <typename T>
+  void flatten_one(T&& value, std::true_type) {
+    flatten_from(std::forward<T>(value));
+  }
+
+  template <typename T>
+  void convert_one(T&& value, std::true_type) {
+    if (std::is_empty<std::decay_t<T>>::value) {
+      std::memset(&storage, 0, sizeof(storage));
+    }
+    new (&storage) std::decay_t<T>(std::forward<T>(value));
+  }
+  template <typename T>
+  void convert_one(T&&, std::false_type) {
+    detail::invalid_tag(tag);
+  }
+
  public:
   template <typename T, typename = decltype(construct(
                             &storage, std::forward<T>(std::declval<T>())))>
-  variant(T&& value) {
-    tag = construct(&storage, std::forward<T>(value));
+  variant(T&& value) noexcept(
+      noexcept(construct(&storage, std::forward<T>(std::declval<T>())))) {
+    this->construct_value(std::forward<T>(value));
   }
 
-  variant(const variant& other) {
-    detail::logger()->debug("variant copy constructor");
+  variant(const variant& other) noexcept(nothrow_copy::value) {
+    if (detail::logging_enabled) {
+      detail::logger()->debug("variant copy constructor");
+    }
     other.visit<void>(
-        [this](auto&& value) { tag = this->construct(&storage, value); });
+        [this](auto&& value) { this->construct_value(value); });
+  }
+  // Converts from a variant<Us...> whose active alternative is one of Ts.
+  // The tag is remapped through a table and, if all of Us are trivially
+  // copyable, the payload is copied bytewise without dispatching on it.
+  template <typename... Us>
+  variant(detail::convert_t, const variant<Us...>& other) noexcept(
+      detail::all_of<!detail::logging_enabled,
+                     std::is_nothrow_copy_constructible<Us>::value...>::value)
+      : tag(detail::tag_remap<typename helper::tag_type,
+                              Ts...>::template from<Us...>(other.tag)) {
+    convert_from(other, trivially_converts_from<Us...>());
+  }
+  template <typename... Us>
+  variant(detail::convert_t, variant<Us...>&& other) noexcept(
+      detail::all_of<!detail::logging_enabled,
+                     std::is_nothrow_move_constructible<Us>::value...>::value)
+      : tag(detail::tag_remap<typename helper::tag_type,
+                              Ts...>::template from<Us...>(other.tag)) {
+    convert_from(std::move(other), trivially_converts_from<Us...>());
+  }
+
+  template <typename... Us,
+            typename = std::enable_if_t<widens_from<Us...>::value>>
+  variant(const variant<Us...>& other) noexcept(
+      noexcept(variant(detail::convert_t(), other)))
+      : variant(detail::convert_t(), other) {}
+  template <typename... Us,
+            typename = std::enable_if_t<widens_from<Us...>::value>>
+  variant(variant<Us...>&& other) noexcept(
+      noexcept(variant(detail::convert_t(), std::move(other))))
+      : variant(detail::convert_t(), std::move(other)) {}
+
+  // Converts from a nested variant, such as variant<variant<A, B>, C> to
+  // variant<A, B, C>, so that later visits dispatch once on a single tag.
+  template <typename... Us,
+            typename = std::enable_if_t<flattens_from<Us...>::value>,
+            typename = void>
+  variant(const variant<Us...>& other) noexcept(
+      std::is_nothrow_copy_constructible<variant<Us...>>::value) {
+    flatten_from(other);
   }
-  variant(variant&& other) {
-    detail::logger()->debug("variant move constructor");
+  template <typename... Us,
+            typename = std::enable_if_t<flattens_from<Us...>::value>,
+            typename = void>
+  variant(variant<Us...>&& other) noexcept(
+      std::is_nothrow_move_constructible<variant<Us...>>::value) {
+    flatten_from(std::move(other));
+  }
+
+  variant(variant&& other) noexcept(nothrow_move::value) {
+    if (detail::logging_enabled) {
+      detail::logger()->debug("variant move constructor");
+    }
     std::move(other).template visit<void>([this](auto&& value) {
-      tag = this->construct(&storage, std::forward<decltype(value)>(value));
+      this->construct_value(std::forward<decltype(value)>(value));
     });
   }
 
   template <typename T, typename = decltype(construct(
                             &storage, std::forward<T>(std::declval<T>())))>
-  variant& operator=(T&& value) {
+  variant& operator=(T&& value) noexcept(
+      nothrow_destroy::value &&
+      noexcept(construct(&storage, std::forward<T>(std::declval<T>())))) {
     destruct();
-    tag = construct(&storage, std::forward<T>(value));
+    this->construct_value(std::forward<T>(value));
     return *this;
   }
 
-  variant& operator=(const variant& other) {
-    detail::logger()->debug("variant copy assignment");
+  variant& operator=(const variant& other) noexcept(
+      nothrow_destroy::value && nothrow_copy::value) {
+    if (detail::logging_enabled) {
+      detail::logger()->debug("variant copy assignment");
+    }
     destruct();
     other.visit<void>(
-        [this](auto&& value) { tag = this->construct(&storage, value); });
+        [this](auto&& value) { this->construct_value(value); });
     return *this;
   }
-  variant& operator=(variant&& other) {
-    detail::logger()->debug("variant move assignment");
+  variant& operator=(variant&& other) noexcept(
+      nothrow_destroy::value && nothrow_move::value) {
+    if (detail::logging_enabled) {
+      detail::logger()->debug("variant move assignment");
+    }
     destruct();
     std::move(other).template visit<void>([this](auto&& value) {
-      tag = this->construct(&storage, std::forward<decltype(value)>(value));
+      this->construct_value(std::forward<decltype(value)>(value));
     });
     return *this;
   }
 
   ~variant() { destruct(); }
 
+  // Returns the value as a V, a variant whose alternatives are a subset of
+  // Ts, if the active alternative is one of them.
+  template <typename V>
+  optional<V> try_narrow() const& {
+    optional<V> result;
+    if (V::template tag_from<Ts...>(tag) < V::size) {
+      result.emplace(detail::convert_t(), *this);
+    }
+    return result;
+  }
+  template <typename V>
+  optional<V> try_narrow() && {
+    optional<V> result;
+    if (V::template tag_from<Ts...>(tag) < V::size) {
+      result.emplace(detail::convert_t(), std::move(*this));
+    }
+    return result;
+  }
+
+  static constexpr std::size_t size = sizeof...(Ts);
+
+  template <typename... Us>
+  static std::size_t tag_from(std::size_t tag) {
+    return detail::tag_remap<typename helper::tag_type,
+                             Ts...>::template from<Us...>(tag);
+  }
+
+  void swap(variant& other) noexcept(
+      is_trivially_relocatable<variant>::value ||
+      (nothrow_destroy::value && nothrow_move::value)) {
+    swap(other, is_trivially_relocatable<variant>());
+  }
+
+ private:
+  void swap(variant& other, std::true_type) noexcept {
+    std::aligned_storage_t<sizeof(variant), alignof(variant)> tmp;
+    auto t = reinterpret_cast<variant*>(&tmp);
+    relocate_at(this, t);
+    relocate_at(&other, this);
+    relocate_at(t, &other);
+  }
+  void swap(variant& other, std::false_type) {
+    variant tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+ public:
   template <typename R, typename F>
   auto visit(F&& f) const& {
-    detail::logger()->debug("visit const &");
+    if (detail::logging_enabled) detail::logger()->debug("visit const &");
     return super_visit::template visit_helper_const<R>(tag, &storage,
                                                        std::forward<F>(f));
   }
   template <typename R, typename F>
   auto visit(F&& f) && {
-    detail::logger()->debug("visit &&");
+    if (detail::logging_enabled) detail::logger()->debug("visit &&");
     return std::move(*this).super_visit::template visit_helper_rvalue<R>(
         tag, &storage, std::forward<F>(f));
   }
@@ -194,9 +621,70 @@ class variant : private detail::variant_helper<Ts...>::super_construct,
   }
 };
 
+// A non-owning, read-only reference to a value of one of Ts, which may live
+// on its own or inside a variant with the same or fewer alternatives.  Taking
+// a view as a visitor parameter instead of a variant<Ts...> avoids copying
+// the payload into a new variant.
+template <typename... Ts>
+class variant_view {
+  using helper = detail::variant_helper<Ts...>;
+  using super_visit = typename helper::super_visit;
+  using tag_type = typename helper::tag_type;
+
+  template <typename... Us>
+  friend class packed_variant_stream;
+
+  variant_view(const void* s, tag_type t) noexcept : storage(s), tag(t) {}
+
+ public:
+  const void* storage;
+  tag_type tag;
+
+  template <typename T, typename = std::enable_if_t<
+                            detail::is_one_of<T, Ts...>::value>>
+  variant_view(const T& value) noexcept
+      : storage(&value), tag(detail::index_of<T, Ts...>::value) {}
+  // A view of a temporary would dangle.  const T&& binds both const and
+  // non-const rvalues, which prefer it to const T&.
+  template <typename T, typename = std::enable_if_t<
+                            detail::is_one_of<T, Ts...>::value>>
+  variant_view(const T&&) = delete;
+
+  template <typename... Us,
+            typename = std::enable_if_t<detail::all_of<
+                detail::is_one_of<Us, Ts...>::value...>::value>>
+  variant_view(const variant<Us...>& v) noexcept
+      : storage(&v.storage),
+        tag(detail::tag_remap<tag_type, Ts...>::template from<Us...>(v.tag)) {}
+  // Likewise for a temporary variant.
+  template <typename... Us>
+  variant_view(const variant<Us...>&&) = delete;
+
+  template <typename R, typename F>
+  auto visit(F&& f) const {
+    return super_visit::template visit_helper_const<R>(tag, storage,
+                                                       std::forward<F>(f));
+  }
+  template <typename R, typename... Fs>
+  auto visit(Fs&&... fs) const {
+    return visit<R>(overload_set<Fs...>(std::forward<Fs>(fs)...));
+  }
+};
+
+template <typename... Ts>
+void swap(variant<Ts...>& a,
+          variant<Ts...>& b) noexcept(noexcept(a.swap(b))) {
+  a.swap(b);
+}
+
+template <typename V>
+flatten_t<std::decay_t<V>> flatten(V&& v) {
+  return flatten_t<std::decay_t<V>>(std::forward<V>(v));
+}
+
 template <typename... Ts>
 std::ostream& operator<<(std::ostream& os, const variant<Ts...>& v) {
-  os << "variant[" << v.tag << "]: ";
+  os << "variant[" << static_cast<unsigned>(v.tag) << "]: ";
   v.template visit<void>([&os](const auto& x) { os << x; });
   return os;
 }
@@ -0,0 +1,87 @@
+#ifndef INCLUDED_ROBOT_H
+#define INCLUDED_ROBOT_H
+
+#include "dispatch_many.hpp"
+#include "event.hpp"
+#include "multivisitor.hpp"
+#include "state.hpp"
+#include "tag_table.hpp"
+#include "updater.hpp"
+#include "variant.hpp"
+
+#include <cmath>
+
+using state = toby::variant<off, idle, turning>;
+using on = toby::variant<idle, turning>;
+
+using event =
+    toby::variant<turn_on, turn_off, start_turning, reset, heading_changed>;
+
+// clang-format off
+inline auto transition_visitor() {
+  return toby::make_multivisitor<state>(
+      [](off,       turn_on)         { return idle{}; },
+      [](off,       const auto&)     { return off{}; },
+      [](on::view,  turn_off)        { return off{}; },
+      [](auto s,    turn_on)         { return s; },
+      [](on::view,  reset)           { return idle{}; },
+      [](on::view,  start_turning e) { return turning{e.target}; },
+      [](idle s,    heading_changed) { return s; },
+      [](turning s, heading_changed e) -> state {
+        if (std::abs(e.heading - s.target) < .1f) {
+          return idle{};
+        } else {
+          return s;
+        }
+      });
+}
+
+inline state transition(const state& s, const event& e) {
+  return transition_visitor()(s, e);
+}
+
+// Applies events to s in order, like s = transition(s, e) for each, but
+// resolves the alternative of s only when an event changes it.
+inline void dispatch_many(state& s, toby::span<const event> events) {
+  auto visitor = transition_visitor();
+  toby::dispatch_many(visitor, s, events);
+}
+
+// transition() in place: s is only assigned when it becomes another state,
+// and a turning robot told to start turning again keeps its payload.
+inline void update(state& s, const event& e) {
+  toby::make_updater(
+      [](off&,      turn_on)         { return idle{}; },
+      [](off&,      const auto&)     { return toby::unchanged{}; },
+      [](on::view,  turn_off)        { return off{}; },
+      [](auto&,     turn_on)         { return toby::unchanged{}; },
+      [](on::view,  reset)           { return idle{}; },
+      [](idle&,     start_turning e) { return turning{e.target}; },
+      [](turning& s, start_turning e) {
+        s.target = e.target;
+        return toby::unchanged{};
+      },
+      [](idle&,     heading_changed) { return toby::unchanged{}; },
+      [](turning& s, heading_changed e)
+          -> toby::variant<toby::unchanged, idle> {
+        if (std::abs(e.heading - s.target) < .1f) {
+          return idle{};
+        } else {
+          return toby::unchanged{};
+        }
+      })(s, e);
+}
+
+// The transitions above that depend only on the tags, so that
+// transition_tags::apply(states, events, n, transition) can skip visiting
+// for them.
+using transition_tags = toby::tag_table<state, event,
+  toby::tag_rule<off,                   turn_on,               idle>,
+  toby::tag_rule<off,                   toby::any_alternative, off>,
+  toby::tag_rule<on,                    turn_off,              off>,
+  toby::tag_rule<toby::any_alternative, turn_on,               toby::keep>,
+  toby::tag_rule<on,                    reset,                 idle>,
+  toby::tag_rule<idle,                  heading_changed,       toby::keep>>;
+// clang-format on
+
+#endif
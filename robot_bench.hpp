@@ -0,0 +1,41 @@
+#ifndef INCLUDED_ROBOT_BENCH_H
+#define INCLUDED_ROBOT_BENCH_H
+
+#include "robot.hpp"
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Relative weights of turn_on, turn_off, start_turning, reset and
+// heading_changed in a fleet that mostly reports its heading.
+inline std::discrete_distribution<int> heading_mix() {
+  return {2, 1, 4, 1, 92};
+}
+
+// n events drawn from pick, with random angles and resets carrying reason.
+inline std::vector<event> make_events(
+    std::size_t n, std::discrete_distribution<int> pick = heading_mix(),
+    const std::string& reason = "watchdog expired") {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> angle(0, 360);
+  std::vector<event> events;
+  events.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    switch (pick(rng)) {
+      case 0: events.push_back(turn_on{}); break;
+      case 1: events.push_back(turn_off{}); break;
+      case 2: events.push_back(start_turning{angle(rng)}); break;
+      case 3: events.push_back(reset{reason}); break;
+      default: events.push_back(heading_changed{angle(rng)}); break;
+    }
+  }
+  return events;
+}
+
+}  // namespace bench
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef INCLUDED_ROBOT_FORMAT_H
+#define INCLUDED_ROBOT_FORMAT_H
+
+#include "event.hpp"
+#include "format.hpp"
+#include "state.hpp"
+
+// Formatters for the robot states and events, matching their operator<<.
+#if FMT_VERSION >= 50000
+
+namespace fmt {
+template <>
+struct formatter<off> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const off&, FormatContext& ctx) const {
+    return fmt::format_to(ctx.out(), "off{{}}");
+  }
+};
+template <>
+struct formatter<idle> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const idle&, FormatContext& ctx) const {
+    return fmt::format_to(ctx.out(), "idle{{}}");
+  }
+};
+template <>
+struct formatter<turning> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const turning& s, FormatContext& ctx) const {
+    return fmt::format_to(ctx.out(), "turning{{{}}}", s.target);
+  }
+};
+template <>
+struct formatter<turn_on> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const turn_on&, FormatContext& ctx) const {
+    return fmt::format_to(ctx.out(), "turn_on{{}}");
+  }
+};
+template <>
+struct formatter<turn_off> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const turn_off&, FormatContext& ctx) const {
+    return fmt::format_to(ctx.out(), "turn_off{{}}");
+  }
+};
+template <>
+struct formatter<start_turning> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const start_turning& e, FormatContext& ctx) const {
+    return fmt::format_to(ctx.out(), "start_turning{{{}}}", e.target);
+  }
+};
+template <>
+struct formatter<reset> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const reset& e, FormatContext& ctx) const {
+    return fmt::format_to(ctx.out(), "reset{{{}}}", e.reason);
+  }
+};
+template <>
+struct formatter<heading_changed> : toby::plain_formatter {
+  template <typename FormatContext>
+  auto format(const heading_changed& e, FormatContext& ctx) const {
+    return fmt::format_to(ctx.out(), "heading_changed{{{}}}", e.heading);
+  }
+};
+}  // namespace fmt
+
+#else
+
+template <typename ArgFormatter>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const off&) {
+  f.writer().write("off{{}}");
+}
+template <typename ArgFormatter>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const idle&) {
+  f.writer().write("idle{{}}");
+}
+template <typename ArgFormatter>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const turning& s) {
+  f.writer().write("turning{{{}}}", s.target);
+}
+template <typename ArgFormatter>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const turn_on&) {
+  f.writer().write("turn_on{{}}");
+}
+template <typename ArgFormatter>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const turn_off&) {
+  f.writer().write("turn_off{{}}");
+}
+template <typename ArgFormatter>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const start_turning& e) {
+  f.writer().write("start_turning{{{}}}", e.target);
+}
+template <typename ArgFormatter>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const reset& e) {
+  f.writer().write("reset{{{}}}", e.reason);
+}
+template <typename ArgFormatter>
+void format_arg(fmt::BasicFormatter<char, ArgFormatter>& f, const char*&,
+                const heading_changed& e) {
+  f.writer().write("heading_changed{{{}}}", e.heading);
+}
+
+#endif
+
+#endif
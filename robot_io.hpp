@@ -0,0 +1,76 @@
+#ifndef INCLUDED_ROBOT_IO_H
+#define INCLUDED_ROBOT_IO_H
+
+#include "compressed_stream.hpp"
+#include "event.hpp"
+#include "serialize.hpp"
+#include "state.hpp"
+#include "text_parser.hpp"
+
+#include <string>
+
+// How robot events and states are serialized, delta compressed and written
+// as text.
+
+// A reset read in place from serialized data.
+struct reset_view {
+  toby::string_view reason;
+};
+
+namespace toby {
+template <>
+struct serializer<start_turning>
+    : member_serializer<start_turning, float, &start_turning::target> {};
+template <>
+struct serializer<heading_changed>
+    : member_serializer<heading_changed, float, &heading_changed::heading> {};
+template <>
+struct serializer<reset> {
+  using view_type = reset_view;
+
+  static void write(writer& w, const reset& e) {
+    serializer<std::string>::write(w, e.reason);
+  }
+  static reset read(reader& r) { return {serializer<std::string>::read(r)}; }
+  static reset_view view(reader& r) {
+    return {serializer<std::string>::view(r)};
+  }
+};
+
+template <>
+struct delta_codec<start_turning>
+    : member_codec<start_turning, float, &start_turning::target> {};
+template <>
+struct delta_codec<heading_changed>
+    : member_codec<heading_changed, float, &heading_changed::heading> {};
+
+template <>
+struct text_format<turn_on> : no_payload<turn_on> {
+  static constexpr const char* name() { return "turn_on"; }
+};
+template <>
+struct text_format<turn_off> : no_payload<turn_off> {
+  static constexpr const char* name() { return "turn_off"; }
+};
+template <>
+struct text_format<start_turning>
+    : member_payload<start_turning, float, &start_turning::target> {
+  static constexpr const char* name() { return "start_turning"; }
+};
+template <>
+struct text_format<reset> : member_payload<reset, std::string, &reset::reason> {
+  static constexpr const char* name() { return "reset"; }
+};
+template <>
+struct text_format<heading_changed>
+    : member_payload<heading_changed, float, &heading_changed::heading> {
+  static constexpr const char* name() { return "heading_changed"; }
+};
+
+// States are serialized for event_log snapshots.
+template <>
+struct serializer<turning>
+    : member_serializer<turning, float, &turning::target> {};
+}  // namespace toby
+
+#endif
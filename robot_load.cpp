@@ -0,0 +1,235 @@
+#include "bench.hpp"
+#include "latency_histogram.hpp"
+#include "robot.hpp"
+#include "robot_bench.hpp"
+#include "robot_protocol.hpp"
+#include "unix_socket.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+struct options {
+  std::string socket = "/tmp/robot_server.sock";
+  std::size_t robots = 100000;
+  std::size_t events = 2000000;
+  std::size_t per_datagram = 16;
+  std::size_t query_every = 1000;
+  std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+  bool shutdown = false;
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--socket", value)) {
+      opts.socket = value;
+    } else if (bench::parse_option(argv[i], "--robots", value)) {
+      opts.robots = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--events", value)) {
+      opts.events = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--per-datagram", value)) {
+      opts.per_datagram = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--query-every", value)) {
+      opts.query_every = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--workers", value)) {
+      opts.workers = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--shutdown", value)) {
+      opts.shutdown = value != "0";
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.robots == 0 || opts.per_datagram == 0 || opts.query_every == 0 ||
+      opts.workers == 0) {
+    throw std::invalid_argument(
+        "--robots, --per-datagram, --query-every and --workers must be "
+        "positive");
+  }
+  return opts;
+}
+
+using clock_type = std::chrono::steady_clock;
+
+std::int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             clock_type::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: robot_load [--socket=PATH] [--robots=N] "
+                 "[--events=N] [--per-datagram=N] [--query-every=N] "
+                 "[--workers=N] [--shutdown=1]\n";
+    return 2;
+  }
+
+  // Interleaved queries measure latency.  Then a barrier query to robot i
+  // for each of the server's --workers shards, which the shard answers only
+  // after applying every event sent before it, waits for all the events.
+  // The server drops replies to a client whose queue is full, so barrier
+  // queries are sent again until answered.
+  const std::size_t probes = opts.events / opts.query_every;
+  const std::size_t barriers = std::min(opts.workers, opts.robots);
+  std::vector<std::atomic<std::int64_t>> sent_ns(probes);
+  std::vector<std::atomic<bool>> answered(barriers);
+  toby::latency_histogram latency;
+  std::atomic<std::size_t> pending{barriers};
+  std::size_t malformed = 0;
+
+  const auto path = opts.socket + ".client." + std::to_string(::getpid());
+  toby::unix_datagram_socket socket;
+  std::remove(path.c_str());
+  try {
+    socket.bind(path);
+    socket.connect(opts.socket);
+    socket.set_receive_timeout(std::chrono::milliseconds(100));
+  } catch (const std::system_error& e) {
+    std::cerr << e.what() << "\n";
+    std::remove(path.c_str());
+    return 1;
+  }
+
+  // The receiver gives up if the server stays silent for timeout_ns.
+  const std::int64_t timeout_ns = 10000000000;
+  std::atomic<bool> abandon{false};
+  auto last = now_ns();
+  std::thread receiver([&] {
+    toby::datagram_batch batch(64);
+    while (pending.load() != 0 && !abandon.load(std::memory_order_relaxed)) {
+      auto n = socket.receive(batch);
+      auto received = now_ns();
+      if (n == 0) {
+        if (received - last > timeout_ns) {
+          abandon.store(true);
+        }
+        continue;
+      }
+      last = received;
+      for (std::size_t i = 0; i < n; ++i) {
+        auto data = batch.data(i);
+        toby::reader r(data.data(), data.size());
+        try {
+          if (protocol::read_kind(r) != protocol::message_kind::reply) {
+            continue;
+          }
+          auto cookie = toby::deserialize<std::uint64_t>(r);
+          if (cookie < probes) {
+            auto sent = sent_ns[cookie].load(std::memory_order_acquire);
+            latency.record(static_cast<std::uint64_t>(received - sent));
+          } else if (cookie - probes < barriers &&
+                     !answered[cookie - probes].exchange(true)) {
+            pending.fetch_sub(1);
+          }
+        } catch (const std::exception&) {
+          // A truncated reply.
+          ++malformed;
+        }
+      }
+    }
+  });
+
+  const auto events = bench::make_events(65521);
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<std::uint32_t> pick_robot(
+      0, static_cast<std::uint32_t>(opts.robots - 1));
+  std::string datagram;
+  std::string query;
+  std::size_t datagrams = 0;
+  std::uint64_t cookie = 0;
+
+  auto start = now_ns();
+  try {
+    std::size_t sent = 0;
+    while (sent < opts.events) {
+      protocol::begin(datagram, protocol::message_kind::events);
+      auto n = std::min(opts.per_datagram, opts.events - sent);
+      for (std::size_t i = 0; i < n; ++i) {
+        protocol::append_event(datagram, pick_robot(rng),
+                               events[(sent + i) % events.size()]);
+      }
+      socket.send(datagram.data(), datagram.size());
+      ++datagrams;
+      for (std::size_t i = 0; i < n; ++i) {
+        if ((sent + i + 1) % opts.query_every == 0 && cookie < probes) {
+          protocol::make_query(query, pick_robot(rng), cookie);
+          sent_ns[cookie].store(now_ns(), std::memory_order_release);
+          socket.send(query.data(), query.size());
+          ++cookie;
+        }
+      }
+      sent += n;
+    }
+    while (pending.load() != 0 && !abandon.load()) {
+      for (std::size_t i = 0; i < barriers; ++i) {
+        if (!answered[i].load()) {
+          protocol::make_query(query, static_cast<std::uint32_t>(i),
+                               probes + i);
+          socket.send(query.data(), query.size());
+        }
+      }
+      for (int wait = 0; wait < 100 && pending.load() != 0; ++wait) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  } catch (const std::system_error& e) {
+    std::cerr << e.what() << "\n";
+    abandon.store(true);
+    receiver.join();
+    std::remove(path.c_str());
+    return 1;
+  }
+  receiver.join();
+  if (pending.load() != 0) {
+    std::cerr << "timed out waiting for replies\n";
+    std::remove(path.c_str());
+    return 1;
+  }
+  // Up to the reply to the last barrier query.
+  auto elapsed = static_cast<double>(last - start) / 1e9;
+  auto lost = probes - latency.count();
+
+  if (opts.shutdown) {
+    protocol::begin(datagram, protocol::message_kind::shutdown);
+    socket.send(datagram.data(), datagram.size());
+  }
+  std::remove(path.c_str());
+
+  std::cout << "{\n"
+            << "  \"robots\": " << opts.robots << ",\n"
+            << "  \"events\": " << opts.events << ",\n"
+            << "  \"datagrams\": " << datagrams << ",\n"
+            << "  \"seconds\": " << elapsed << ",\n"
+            << "  \"events_per_second\": " << opts.events / elapsed << ",\n"
+            << "  \"queries\": " << latency.count() << ",\n"
+            << "  \"replies_lost\": " << lost << ",\n"
+            << "  \"replies_malformed\": " << malformed << ",\n"
+            << "  \"query_p50_us\": " << latency.percentile(0.5) / 1e3
+            << ",\n"
+            << "  \"query_p99_us\": " << latency.percentile(0.99) / 1e3
+            << ",\n"
+            << "  \"query_p999_us\": " << latency.percentile(0.999) / 1e3
+            << "\n"
+            << "}\n";
+}
@@ -0,0 +1,59 @@
+#ifndef INCLUDED_ROBOT_PROTOCOL_H
+#define INCLUDED_ROBOT_PROTOCOL_H
+
+#include "robot.hpp"
+#include "robot_io.hpp"
+#include "serialize.hpp"
+
+#include <cstdint>
+#include <string>
+
+// Datagrams exchanged by robot_server and robot_load over a Unix socket.
+// Every datagram starts with a message_kind byte:
+//
+//   events:   ({u32 robot} {event})...
+//   query:    {u32 robot} {u64 cookie}
+//   reply:    {u64 cookie} {state}, sent back to the querying socket once
+//             every event sent before the query has been applied
+//   shutdown: nothing; stops the server
+namespace protocol {
+
+enum class message_kind : std::uint8_t { events, query, reply, shutdown };
+
+inline void begin(std::string& out, message_kind kind) {
+  out.clear();
+  toby::writer w(out);
+  toby::serialize(w, static_cast<std::uint8_t>(kind));
+}
+
+inline void append_event(std::string& out, std::uint32_t robot,
+                         const event& e) {
+  toby::writer w(out);
+  toby::serialize(w, robot);
+  toby::serialize(w, e);
+}
+
+inline void make_query(std::string& out, std::uint32_t robot,
+                       std::uint64_t cookie) {
+  begin(out, message_kind::query);
+  toby::writer w(out);
+  toby::serialize(w, robot);
+  toby::serialize(w, cookie);
+}
+
+inline void make_reply(std::string& out, std::uint64_t cookie,
+                       const state& s) {
+  begin(out, message_kind::reply);
+  toby::writer w(out);
+  toby::serialize(w, cookie);
+  toby::serialize(w, s);
+}
+
+// Reads the kind byte; throws toby::deserialize_error on an empty datagram.
+inline message_kind read_kind(toby::reader& r) {
+  return static_cast<message_kind>(toby::deserialize<std::uint8_t>(r));
+}
+
+}  // namespace protocol
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef INCLUDED_ROBOT_QUEUES_H
+#define INCLUDED_ROBOT_QUEUES_H
+
+#include "coalescing_queue.hpp"
+#include "event.hpp"
+#include "lane_queue.hpp"
+
+#include <cstddef>
+#include <type_traits>
+
+// How robot events are merged in a coalescing_queue and ordered in a
+// lane_queue.
+
+namespace toby {
+// Only the latest target matters, and repeating a switch changes nothing.
+// Keeping only the latest heading is an approximation: a turning robot whose
+// merged reports passed within 0.1 of its target and then moved away keeps
+// turning, where applying every report would have left it idle.  It stops
+// at the next report close to its target.
+template <>
+struct coalescing<turn_on>
+    : std::integral_constant<coalesce_policy,
+                             coalesce_policy::drop_duplicates> {};
+template <>
+struct coalescing<turn_off>
+    : std::integral_constant<coalesce_policy,
+                             coalesce_policy::drop_duplicates> {};
+template <>
+struct coalescing<start_turning>
+    : std::integral_constant<coalesce_policy, coalesce_policy::keep_latest> {
+};
+template <>
+struct coalescing<heading_changed>
+    : std::integral_constant<coalesce_policy, coalesce_policy::keep_latest> {
+};
+
+// Safety events overtake everything else in a lane_queue.
+template <>
+struct priority_lane<turn_off> : std::integral_constant<std::size_t, 1> {};
+template <>
+struct priority_lane<reset> : std::integral_constant<std::size_t, 1> {};
+}  // namespace toby
+
+#endif
@@ -0,0 +1,262 @@
+#include "bench.hpp"
+#include "robot.hpp"
+#include "robot_protocol.hpp"
+#include "sharded_runtime.hpp"
+#include "unix_socket.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::string socket = "/tmp/robot_server.sock";
+  std::size_t robots = 100000;
+  std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t batch = 64;
+};
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (bench::parse_option(argv[i], "--socket", value)) {
+      opts.socket = value;
+    } else if (bench::parse_option(argv[i], "--robots", value)) {
+      opts.robots = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--workers", value)) {
+      opts.workers = bench::parse_count(value);
+    } else if (bench::parse_option(argv[i], "--batch", value)) {
+      opts.batch = bench::parse_count(value);
+    } else {
+      throw std::invalid_argument(std::string("unknown option: ") + argv[i]);
+    }
+  }
+  if (opts.robots == 0 || opts.workers == 0 || opts.batch == 0) {
+    throw std::invalid_argument(
+        "--robots, --workers and --batch must be positive");
+  }
+  return opts;
+}
+
+// A query travels through the same shard ring as the robot's events, so it
+// is answered only after every event received before it.
+struct query {
+  std::uint64_t cookie;
+  std::uint32_t client;
+};
+
+// Flattened so that shard threads dispatch on a single tag.
+using request = toby::flatten_t<toby::variant<event, query>>;
+
+// Addresses of the sockets that have sent queries.  Only the receive thread
+// adds clients; shard threads read an address after the query naming it
+// comes out of their ring.
+class client_table {
+ private:
+  std::vector<sockaddr_un> m_addresses;
+  std::vector<socklen_t> m_sizes;
+  std::map<std::string, std::uint32_t> m_ids;
+
+ public:
+  explicit client_table(std::size_t capacity)
+      : m_addresses(capacity), m_sizes(capacity) {}
+
+  // Returns false if the table is full.
+  bool find_or_add(const sockaddr_un& addr, socklen_t size,
+                   std::uint32_t& id) {
+    std::string key(reinterpret_cast<const char*>(&addr), size);
+    auto it = m_ids.find(key);
+    if (it != m_ids.end()) {
+      id = it->second;
+      return true;
+    }
+    if (m_ids.size() == m_addresses.size()) {
+      return false;
+    }
+    id = static_cast<std::uint32_t>(m_ids.size());
+    m_addresses[id] = addr;
+    m_sizes[id] = size;
+    m_ids.emplace(std::move(key), id);
+    return true;
+  }
+
+  const sockaddr_un& address(std::uint32_t id) const {
+    return m_addresses[id];
+  }
+  socklen_t size(std::uint32_t id) const { return m_sizes[id]; }
+};
+
+// Replies never block a shard thread: a reply to a client whose queue is
+// full is dropped and counted.
+struct server_step {
+  toby::unix_datagram_socket* socket;
+  const client_table* clients;
+  std::atomic<std::uint64_t>* dropped;
+
+  state operator()(const state& s, const request& r) const {
+    return r.visit<state>(
+        [&](const auto& e) { return transition(s, e); },
+        [&](const query& q) {
+          std::string reply;
+          protocol::make_reply(reply, q.cookie, s);
+          try {
+            if (!socket->try_send_to(clients->address(q.client),
+                                     clients->size(q.client), reply.data(),
+                                     reply.size())) {
+              dropped->fetch_add(1, std::memory_order_relaxed);
+            }
+          } catch (const std::system_error&) {
+            // The client has gone away.
+            dropped->fetch_add(1, std::memory_order_relaxed);
+          }
+          return s;
+        });
+  }
+};
+
+using runtime_type = toby::sharded_runtime<state, request, server_step>;
+
+std::atomic<bool> g_stop{false};
+
+extern "C" void on_signal(int) { g_stop.store(true); }
+
+// Waits for room in the robot's shard, unless the server is told to stop.
+template <typename E>
+bool send_request(runtime_type::producer& producer, std::uint32_t robot,
+                  E&& e) {
+  while (!producer.try_send(robot, std::forward<E>(e))) {
+    if (g_stop.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  options opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n"
+              << "usage: robot_server [--socket=PATH] [--robots=N] "
+                 "[--workers=N] [--batch=N]\n";
+    return 2;
+  }
+
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+
+  toby::unix_datagram_socket socket;
+  client_table clients(4096);
+  std::remove(opts.socket.c_str());
+  try {
+    socket.bind(opts.socket);
+    socket.set_receive_timeout(std::chrono::milliseconds(100));
+  } catch (const std::system_error& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::atomic<std::uint64_t> dropped_replies{0};
+  runtime_type runtime(opts.robots, opts.workers, 1, off{},
+                       server_step{&socket, &clients, &dropped_replies});
+  auto producer = runtime.make_producer(0);
+
+  toby::datagram_batch batch(opts.batch);
+  std::uint64_t receives = 0;
+  std::uint64_t datagrams = 0;
+  std::uint64_t events = 0;
+  std::uint64_t queries = 0;
+  std::uint64_t rejected = 0;
+
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  while (!g_stop.load(std::memory_order_relaxed)) {
+    auto n = socket.receive(batch);
+    if (n == 0) {
+      continue;
+    }
+    ++receives;
+    datagrams += n;
+    for (std::size_t i = 0; i < n; ++i) {
+      auto data = batch.data(i);
+      toby::reader r(data.data(), data.size());
+      try {
+        switch (protocol::read_kind(r)) {
+          case protocol::message_kind::events:
+            while (!r.empty()) {
+              auto robot = toby::deserialize<std::uint32_t>(r);
+              auto e = toby::deserialize<event>(r);
+              if (robot >= opts.robots) {
+                ++rejected;
+                continue;
+              }
+              if (!send_request(producer, robot, std::move(e))) {
+                break;
+              }
+              ++events;
+            }
+            break;
+          case protocol::message_kind::query: {
+            auto robot = toby::deserialize<std::uint32_t>(r);
+            auto cookie = toby::deserialize<std::uint64_t>(r);
+            std::uint32_t client;
+            if (robot >= opts.robots ||
+                !clients.find_or_add(batch.from(i), batch.from_size(i),
+                                     client)) {
+              ++rejected;
+              break;
+            }
+            if (send_request(producer, robot, query{cookie, client})) {
+              ++queries;
+            }
+            break;
+          }
+          case protocol::message_kind::shutdown:
+            g_stop.store(true);
+            break;
+          default:
+            ++rejected;
+            break;
+        }
+      } catch (const std::exception&) {
+        // Truncated data or an invalid event tag.
+        ++rejected;
+      }
+    }
+  }
+  runtime.stop();
+  auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+  std::remove(opts.socket.c_str());
+
+  std::cout << "{\n"
+            << "  \"robots\": " << opts.robots << ",\n"
+            << "  \"workers\": " << opts.workers << ",\n"
+            << "  \"seconds\": " << elapsed << ",\n"
+            << "  \"receive_calls\": " << receives << ",\n"
+            << "  \"datagrams\": " << datagrams << ",\n"
+            << "  \"datagrams_per_receive\": "
+            << (receives ? static_cast<double>(datagrams) / receives : 0)
+            << ",\n"
+            << "  \"events\": " << events << ",\n"
+            << "  \"queries\": " << queries << ",\n"
+            << "  \"rejected\": " << rejected << ",\n"
+            << "  \"dropped_replies\": " << dropped_replies.load() << "\n"
+            << "}\n";
+}
@@ -1,3 +1,6 @@
+#ifndef INCLUDED_STATE_H
+#define INCLUDED_STATE_H
+
 #include <iostream>
 
 struct off {};
@@ -6,10 +9,14 @@ struct turning {
   float target;
 };
 
-std::ostream& operator<<(std::ostream& os, const off&) { return os << "off{}"; }
-std::ostream& operator<<(std::ostream& os, const idle&) {
+inline std::ostream& operator<<(std::ostream& os, const off&) {
+  return os << "off{}";
+}
+inline std::ostream& operator<<(std::ostream& os, const idle&) {
   return os << "idle{}";
 }
-std::ostream& operator<<(std::ostream& os, const turning& s) {
+inline std::ostream& operator<<(std::ostream& os, const turning& s) {
   return os << "turning{" << s.target << "}";
 }
+
+#endif
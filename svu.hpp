@@ -0,0 +1,97 @@
+#ifndef INCLUDED_SVU_H
+#define INCLUDED_SVU_H
+
+#include "overload_set.hpp"
+
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class svu {
+ private:
+  enum { STRING, VECTOR } tag;
+  union {
+    std::string s;
+    std::vector<int> v;
+  };
+
+ public:
+  template <typename R, typename F>
+  R visit(F&& f) {
+    switch (tag) {
+      case STRING: return f(s);
+      case VECTOR: return f(v);
+    }
+    throw std::logic_error("Bad tag");
+  }
+  template <typename R, typename F>
+  R visit(F&& f) const {
+    return const_cast<svu*>(this)->visit<R>([f = std::forward<F>(f)](auto&& x) {
+      return f(const_cast<std::add_const_t<decltype(x)>>(x));
+    });
+  }
+
+  template <typename R, typename... Fs>
+  auto visit(Fs&&... fs) {
+    return visit<R>(toby::overload_set<Fs...>(std::forward<Fs>(fs)...));
+  }
+  template <typename R, typename... Fs>
+  auto visit(Fs&&... fs) const {
+    return visit<R>(toby::overload_set<Fs...>(std::forward<Fs>(fs)...));
+  }
+
+ private:
+  void construct(const std::string& _s) {
+    tag = STRING;
+    new (&s) std::string(_s);
+  }
+  void construct(const std::vector<int>& _v) {
+    tag = VECTOR;
+    new (&v) std::vector<int>(_v);
+  }
+  void construct(std::string&& _s) {
+    tag = STRING;
+    new (&s) std::string(std::move(_s));
+  }
+  void construct(std::vector<int>&& _v) {
+    tag = VECTOR;
+    new (&v) std::vector<int>(std::move(_v));
+  }
+  void destruct() {
+    visit<void>([](auto&& x) {
+      using T = std::decay_t<decltype(x)>;
+      x.~T();
+    });
+  }
+
+ public:
+  template <typename T>
+  svu(const T& x) {
+    construct(x);
+  }
+
+  svu(const svu& other) {
+    other.visit<void>([this](auto&& v) { construct(v); });
+  }
+  svu(svu&& other) {
+    other.visit<void>([this](auto&& v) { construct(std::move(v)); });
+  }
+
+  svu& operator=(const svu& other) {
+    destruct();
+    other.visit<void>([this](auto&& v) { construct(v); });
+    return *this;
+  }
+  svu& operator=(svu&& other) {
+    destruct();
+    other.visit<void>([this](auto&& v) { construct(std::move(v)); });
+    return *this;
+  }
+
+  ~svu() { destruct(); }
+};
+
+#endif
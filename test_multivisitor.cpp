@@ -1,10 +1,43 @@
+#include "alloc_counter.hpp"
+#include "charconv.hpp"
+#include "coalescing_queue.hpp"
+#include "compressed_stream.hpp"
+#include "dispatch_many.hpp"
+#include "event.hpp"
+#include "format.hpp"
+#include "lane_queue.hpp"
+#include "latency_histogram.hpp"
+#include "mpsc_ring.hpp"
 #include "multivisitor.hpp"
+#include "packed_variant_stream.hpp"
+#include "parallel.hpp"
+#include "robot.hpp"
+#include "robot_io.hpp"
+#include "robot_queues.hpp"
+#include "serialize.hpp"
+#include "sharded_runtime.hpp"
+#include "spsc_ring.hpp"
+#include "tag_table.hpp"
+#include "text_parser.hpp"
+#include "updater.hpp"
 #include "variant.hpp"
 
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 using toby::variant;
+using toby::flatten_t;
 using toby::make_multivisitor;
 
 struct special_member_counts {
@@ -14,7 +47,8 @@ struct special_member_counts {
   int num_copy_assignment;
   int num_move_assignment;
   int num_destructor;
-} counts;
+};
+thread_local special_member_counts counts;
 
 struct special_member_counter {
   special_member_counter() { ++counts.num_default_constructor; }
@@ -80,4 +114,1095 @@ TEST_CASE("using multivisitor does not make any copies", "[multivisitor]") {
   }
 }
 
+template <std::size_t N>
+struct indexed {};
+
+template <typename Is>
+struct indexed_variant;
+
+template <std::size_t... I>
+struct indexed_variant<std::index_sequence<I...>> {
+  using type = variant<indexed<I>...>;
+};
+
+struct index_of {
+  template <std::size_t N>
+  std::size_t operator()(indexed<N>) const {
+    return N;
+  }
+};
+
+TEST_CASE("visit dispatches to the active alternative", "[variant]") {
+  using small = indexed_variant<std::make_index_sequence<5>>::type;
+  REQUIRE(small(indexed<0>{}).visit<std::size_t>(index_of{}) == 0);
+  REQUIRE(small(indexed<4>{}).visit<std::size_t>(index_of{}) == 4);
+
+  using large = indexed_variant<std::make_index_sequence<70>>::type;
+  REQUIRE(large(indexed<0>{}).visit<std::size_t>(index_of{}) == 0);
+  REQUIRE(large(indexed<63>{}).visit<std::size_t>(index_of{}) == 63);
+  REQUIRE(large(indexed<69>{}).visit<std::size_t>(index_of{}) == 69);
+}
+TEST_CASE("visiting a variant with an invalid tag throws", "[variant]") {
+  variant<int, float> v(1);
+  v.tag = 2;
+  REQUIRE_THROWS_AS(v.visit<void>([](auto) {}), const std::logic_error&);
+
+  // Converting keeps the tag invalid rather than making it look valid.
+  variant<double, float, int> w(v);
+  REQUIRE(w.tag == 3);
+  REQUIRE_THROWS_AS(w.visit<void>([](auto) {}), const std::logic_error&);
+  w.tag = 0;
+  v.tag = 0;
+}
+
+int* volatile leaked_int;
+
+TEST_CASE("alloc_counter counts allocations on the calling thread",
+          "[alloc_counter]") {
+  auto counts = alloc_counter::count([] { leaked_int = new int(42); });
+  REQUIRE(counts.allocations == 1);
+  REQUIRE(counts.bytes_allocated == sizeof(int));
+  counts = alloc_counter::count([] { delete leaked_int; });
+  REQUIRE(counts.allocations == 0);
+  REQUIRE(counts.deallocations == 1);
+}
+TEST_CASE("visit does not allocate", "[variant][alloc_counter]") {
+  variant<int, std::string> v(std::string(100, 'x'));
+  std::size_t size = 0;
+  REQUIRE_NO_ALLOCATIONS(size = v.visit<std::size_t>(
+                             [](int) { return std::size_t(0); },
+                             [](const std::string& s) { return s.size(); }));
+  REQUIRE(size == 100);
+  REQUIRE_NO_ALLOCATIONS(std::move(v).visit<void>([](auto&&) {}));
+}
+TEST_CASE("multivisitor does not allocate", "[multivisitor][alloc_counter]") {
+  variant<int, std::string> v1(std::string(100, 'x'));
+  variant<int, std::string> v2(1);
+  auto visitor = make_multivisitor<std::size_t>(
+      [](const auto&, const auto&) { return std::size_t(1); },
+      [](const std::string& s, int i) { return s.size() + i; });
+  std::size_t result = 0;
+  REQUIRE_NO_ALLOCATIONS(result = visitor(v1, v2));
+  REQUIRE(result == 101);
+}
+TEST_CASE(
+    "assigning between same-sized trivially copyable alternatives does not "
+    "allocate",
+    "[variant][alloc_counter]") {
+  using v_type = variant<std::int32_t, float, std::uint32_t>;
+  v_type v(1);
+  const v_type f(2.5f);
+  REQUIRE_NO_ALLOCATIONS(v = 3.5f);
+  REQUIRE_NO_ALLOCATIONS(v = std::uint32_t(7));
+  REQUIRE_NO_ALLOCATIONS(v = f);
+  REQUIRE_NO_ALLOCATIONS(v = v_type(std::int32_t(4)));
+  REQUIRE(v.tag == 0);
+}
+
+struct relocatable_counter : special_member_counter {};
+
+namespace toby {
+template <>
+struct is_trivially_relocatable<relocatable_counter> : std::true_type {};
+}
+
+static_assert(toby::is_trivially_relocatable<variant<int, float>>::value,
+              "trivially copyable alternatives are trivially relocatable");
+static_assert(
+    toby::is_trivially_relocatable<variant<int, relocatable_counter>>::value,
+    "opted-in alternatives are trivially relocatable");
+static_assert(
+    !toby::is_trivially_relocatable<variant<int, special_member_counter>>::
+        value,
+    "alternatives are not trivially relocatable by default");
+
+TEST_CASE("swapping trivially relocatable variants copies bytes",
+          "[variant][relocate]") {
+  variant<int, relocatable_counter> v1(1);
+  variant<int, relocatable_counter> v2(relocatable_counter{});
+  counts = {};
+  swap(v1, v2);
+  REQUIRE(v1.tag == 1);
+  REQUIRE(v2.tag == 0);
+  REQUIRE(v2.visit<int>([](int i) { return i; },
+                        [](const relocatable_counter&) { return -1; }) == 1);
+  REQUIRE(counts.num_copy_constructor == 0);
+  REQUIRE(counts.num_move_constructor == 0);
+  REQUIRE(counts.num_destructor == 0);
+}
+TEST_CASE("swapping other variants moves through a temporary",
+          "[variant][relocate]") {
+  variant<int, special_member_counter> v1(1);
+  variant<int, special_member_counter> v2(special_member_counter{});
+  counts = {};
+  swap(v1, v2);
+  REQUIRE(v1.tag == 1);
+  REQUIRE(v2.tag == 0);
+  REQUIRE(counts.num_copy_constructor == 0);
+  REQUIRE(counts.num_move_constructor == 2);
+  REQUIRE(counts.num_destructor == 2);
+}
+TEST_CASE("relocating an array of variants makes no special member calls",
+          "[variant][relocate]") {
+  using v_type = variant<int, relocatable_counter>;
+  using slot = std::aligned_storage_t<sizeof(v_type), alignof(v_type)>;
+  slot from[3];
+  slot to[3];
+  auto first = reinterpret_cast<v_type*>(from);
+  auto d_first = reinterpret_cast<v_type*>(to);
+  new (first + 0) v_type(0);
+  new (first + 1) v_type(relocatable_counter{});
+  new (first + 2) v_type(2);
+  counts = {};
+  auto d_last = toby::uninitialized_relocate(first, first + 3, d_first);
+  REQUIRE(d_last == d_first + 3);
+  REQUIRE(counts.num_move_constructor == 0);
+  REQUIRE(counts.num_destructor == 0);
+  REQUIRE(d_first[1].tag == 1);
+  REQUIRE(d_first[2].visit<int>([](int i) { return i; },
+                                [](const relocatable_counter&) {
+                                  return -1;
+                                }) == 2);
+  for (auto p = d_first; p != d_last; ++p) {
+    p->~v_type();
+  }
+  REQUIRE(counts.num_destructor == 1);
+}
+
+struct nothrow_counter : special_member_counter {
+  nothrow_counter() = default;
+  nothrow_counter(const nothrow_counter&) = default;
+  nothrow_counter(nothrow_counter&& other) noexcept
+      : special_member_counter(std::move(other)) {}
+};
+
+struct throwing_move {
+  throwing_move() = default;
+  throwing_move(const throwing_move&) = default;
+  throwing_move(throwing_move&&) noexcept(false) {}
+};
+
+using string_variant = variant<std::string, std::vector<int>>;
+
+// Members that log can throw, so with logging on nothing is noexcept.
+constexpr bool quiet = !toby::detail::logging_enabled;
+
+static_assert(std::is_nothrow_move_constructible<string_variant>::value ==
+                  quiet,
+              "move construction is noexcept if all alternatives' are");
+static_assert(std::is_nothrow_move_assignable<string_variant>::value == quiet,
+              "move assignment is noexcept if all alternatives' moves are");
+static_assert(!std::is_nothrow_copy_constructible<string_variant>::value,
+              "copying strings can throw");
+static_assert(!std::is_nothrow_copy_assignable<string_variant>::value,
+              "copying strings can throw");
+static_assert(std::is_nothrow_copy_constructible<variant<int, float>>::value ==
+                  quiet,
+              "copying ints and floats cannot throw");
+static_assert(
+    std::is_nothrow_constructible<string_variant, std::string&&>::value ==
+        quiet,
+    "moving a string into a variant cannot throw");
+static_assert(
+    !std::is_nothrow_constructible<string_variant, const char*>::value,
+    "converting to a string can throw");
+static_assert(
+    std::is_nothrow_assignable<string_variant&, std::string&&>::value == quiet,
+    "moving a string into a variant cannot throw");
+static_assert(
+    !std::is_nothrow_move_constructible<variant<int, throwing_move>>::value,
+    "move construction can throw if any alternative's can");
+static_assert(
+    !std::is_nothrow_move_assignable<variant<int, throwing_move>>::value,
+    "move assignment can throw if any alternative's move can");
+static_assert(noexcept(std::declval<string_variant&>().swap(
+                  std::declval<string_variant&>())) == quiet,
+              "swap is noexcept if all alternatives are nothrow movable");
+
+TEST_CASE("vector growth moves variants with noexcept moves",
+          "[variant][noexcept]") {
+  std::vector<variant<nothrow_counter>> v;
+  v.push_back(nothrow_counter{});
+  counts = {};
+  v.reserve(v.capacity() + 1);
+  if (quiet) {
+    REQUIRE(counts.num_copy_constructor == 0);
+    REQUIRE(counts.num_move_constructor == 1);
+  } else {
+    REQUIRE(counts.num_copy_constructor == 1);
+    REQUIRE(counts.num_move_constructor == 0);
+  }
+}
+
+TEST_CASE("multivisitor passes variant_view parameters without copying",
+          "[multivisitor][variant_view]") {
+  using sub = variant<special_member_counter, int>;
+  auto which = [](sub::view s) {
+    return s.visit<int>([](const special_member_counter&) { return 1; },
+                        [](int) { return 2; });
+  };
+  variant<special_member_counter, int, float> v1(special_member_counter{});
+  variant<int> v2(1);
+
+  counts = {};
+  auto by_view = make_multivisitor<int>(
+      [&](sub::view s, int) { return which(s); }, [](float, int) { return 3; });
+  REQUIRE(by_view(v1, v2) == 1);
+  REQUIRE(counts.num_copy_constructor == 0);
+  REQUIRE(counts.num_move_constructor == 0);
+
+  counts = {};
+  auto by_value = make_multivisitor<int>(
+      [&](sub s, int) { return which(s); }, [](float, int) { return 3; });
+  REQUIRE(by_value(v1, v2) == 1);
+  REQUIRE(counts.num_copy_constructor == 1);
+}
+TEST_CASE("a variant_view of a narrower variant remaps its tag",
+          "[variant_view]") {
+  variant<float, int> v(1);
+  toby::variant_view<int, std::string, float> view(v);
+  REQUIRE(view.tag == 0);
+  REQUIRE(view.storage == &v.storage);
+  REQUIRE(view.visit<int>([](int i) { return i; },
+                          [](const auto&) { return -1; }) == 1);
+  v = 2.5f;
+  view = v;
+  REQUIRE(view.tag == 2);
+}
+
+static_assert(!std::is_constructible<toby::variant_view<int, float>,
+                                     variant<float, int>&&>::value,
+              "a view of a temporary variant would dangle");
+static_assert(!std::is_constructible<toby::variant_view<int, std::string>,
+                                     std::string&&>::value,
+              "a view of a temporary alternative would dangle");
+static_assert(!std::is_constructible<toby::variant_view<int, std::string>,
+                                     const std::string&&>::value,
+              "a view of a temporary alternative would dangle");
+static_assert(std::is_constructible<toby::variant_view<int, std::string>,
+                                    const std::string&>::value,
+              "a view of an alternative is fine");
+
+TEST_CASE("a variant converts to a variant with more alternatives",
+          "[variant][convert]") {
+  variant<float, int> narrow(2);
+  variant<std::string, int, float> wide(narrow);
+  REQUIRE(wide.tag == 1);
+  REQUIRE(wide.visit<int>([](int i) { return i; },
+                          [](const auto&) { return -1; }) == 2);
+
+  variant<std::string, int> a(std::string(100, 'x'));
+  variant<double, int, std::string> b(a);
+  REQUIRE(b.tag == 2);
+  REQUIRE(b.visit<std::size_t>([](const std::string& s) { return s.size(); },
+                               [](const auto&) { return 0; }) == 100);
+
+  variant<special_member_counter, int> c(special_member_counter{});
+  counts = {};
+  variant<int, special_member_counter, float> d(std::move(c));
+  REQUIRE(d.tag == 1);
+  REQUIRE(counts.num_copy_constructor == 0);
+  REQUIRE(counts.num_move_constructor == 1);
+}
+TEST_CASE("try_narrow converts to a variant with fewer alternatives",
+          "[variant][convert]") {
+  variant<std::string, int, float> v(2.5f);
+  auto narrowed = v.try_narrow<variant<float, int>>();
+  REQUIRE(narrowed);
+  REQUIRE(narrowed->tag == 0);
+  REQUIRE(narrowed->visit<float>([](float f) { return f; },
+                                 [](int) { return 0.f; }) == 2.5f);
+
+  v = std::string("hello");
+  REQUIRE_FALSE((v.try_narrow<variant<float, int>>()));
+  auto s = std::move(v).try_narrow<variant<int, std::string>>();
+  REQUIRE(s);
+  REQUIRE(s->tag == 1);
+}
+
+TEST_CASE("nested variants flatten into one variant", "[variant][flatten]") {
+  using inner = variant<int, std::string>;
+  using nested = variant<inner, float, variant<double, inner>>;
+  static_assert(
+      std::is_same<flatten_t<nested>,
+                   variant<int, std::string, float, double>>::value,
+      "flatten_t");
+
+  nested v(inner(std::string("hello")));
+  auto flat = flatten(v);
+  REQUIRE(flat.tag == 1);
+  REQUIRE(flat.visit<std::string>(
+              [](const std::string& s) { return s; },
+              [](const auto&) { return std::string(); }) == "hello");
+
+  nested w(variant<double, inner>(inner(7)));
+  flatten_t<nested> flat_w(std::move(w));
+  REQUIRE(flat_w.tag == 0);
+  REQUIRE(flatten(nested(2.5f)).tag == 2);
+}
+
+TEST_CASE("fmt formats the active alternative", "[variant][format]") {
+  variant<int, std::string> v(std::string("hello"));
+  REQUIRE(fmt::format("{}", v) == "variant[1]: hello");
+  std::ostringstream os;
+  os << v;
+  REQUIRE(os.str() == fmt::format("{}", v));
+}
+
+TEST_CASE("variants serialize to a tag and a little-endian payload",
+          "[variant][serialize]") {
+  using message = variant<turn_on, start_turning, reset>;
+  auto bytes = toby::serialize(message(start_turning{1.0f}));
+  REQUIRE(bytes == std::string("\x01\x00\x00\x00\x80\x3f", 6));
+
+  std::string out;
+  toby::writer w(out);
+  toby::serialize(w, message(reset{"watchdog"}));
+  toby::serialize(w, message(turn_on{}));
+  toby::reader r(out.data(), out.size());
+  auto first = toby::deserialize<message>(r);
+  REQUIRE(first.tag == 2);
+  REQUIRE(first.visit<std::string>([](const reset& e) { return e.reason; },
+                                   [](const auto&) { return ""; }) ==
+          "watchdog");
+  REQUIRE(toby::deserialize<message>(r).tag == 0);
+  REQUIRE(r.empty());
+
+  toby::reader truncated(out.data(), 5);
+  REQUIRE_THROWS_AS(toby::deserialize<message>(truncated),
+                    const toby::deserialize_error&);
+  std::string bad_tag("\x07\x00", 2);
+  toby::reader bad(bad_tag.data(), bad_tag.size());
+  REQUIRE_THROWS_AS(toby::deserialize<message>(bad),
+                    const toby::deserialize_error&);
+}
+TEST_CASE("text lines parse into variants", "[variant][text_parser]") {
+  using message = variant<turn_on, start_turning, reset>;
+  const std::string text =
+      "turn_on\nstart_turning -12.5\n\nreset \"say \\\"hi\\\"\"\r\nturn_on";
+  toby::text_parser<message> parser;
+  message out[2] = {turn_on{}, turn_on{}};
+
+  // Split the input mid-line and fill the buffer before it is consumed.
+  auto first = text.data();
+  auto cut = text.data() + 10;
+  auto r = parser.parse(first, cut, out, 2);
+  REQUIRE(r.count == 1);
+  REQUIRE(r.ptr == cut);
+  REQUIRE(out[0].tag == 0);
+  r = parser.parse(cut, text.data() + text.size(), out, 2);
+  REQUIRE(r.count == 2);
+  REQUIRE(out[0].visit<float>([](start_turning e) { return e.target; },
+                              [](const auto&) { return 0.f; }) == -12.5f);
+  REQUIRE(out[1].visit<std::string>([](const reset& e) { return e.reason; },
+                                    [](const auto&) { return ""; }) ==
+          "say \"hi\"");
+  REQUIRE(parser.parse(r.ptr, text.data() + text.size(), out, 2).count == 0);
+  REQUIRE(parser.finish(out[0]));
+  REQUIRE(out[0].tag == 0);
+  REQUIRE(parser.line() == 5);
+
+  const std::string numbers = "start_turning 1\nstart_turning 2.5e1\n";
+  REQUIRE_NO_ALLOCATIONS(parser.parse(
+      numbers.data(), numbers.data() + numbers.size(), out, 2));
+
+  // Parsing continues after a malformed line in the middle of the input.
+  const std::string bad = "turn_on\nturn_off\nstart_turning 3\n";
+  const char* resume = nullptr;
+  try {
+    parser.parse(bad.data(), bad.data() + bad.size(), out, 2);
+    FAIL("expected a parse error");
+  } catch (const toby::parse_error& e) {
+    REQUIRE(e.line() == 9);
+    REQUIRE(e.parsed() == 1);
+    resume = e.resume();
+  }
+  REQUIRE(resume == bad.data() + 17);
+  r = parser.parse(resume, bad.data() + bad.size(), out, 2);
+  REQUIRE(r.count == 1);
+  REQUIRE(out[0].tag == 1);
+
+  // A line cut off by a chunk boundary and then found to be malformed is not
+  // carried into the next call.
+  const std::string chunks = "turn_on\nstart_tur" "ning x\n" "turn_on\n";
+  REQUIRE(parser.parse(chunks.data(), chunks.data() + 17, out, 2).count == 1);
+  try {
+    parser.parse(chunks.data() + 17, chunks.data() + chunks.size(), out, 2);
+    FAIL("expected a parse error");
+  } catch (const toby::parse_error& e) {
+    REQUIRE(e.resume() == chunks.data() + 24);
+  }
+  r = parser.parse(chunks.data() + 24, chunks.data() + chunks.size(), out, 2);
+  REQUIRE(r.count == 1);
+  REQUIRE(out[0].tag == 0);
+}
+
+TEST_CASE("floats are parsed with a single rounding", "[charconv]") {
+  // Just above halfway between 1 and the next float; rounding it to double
+  // first gives exactly halfway, which would then round down to 1.
+  const std::string text = "1.000000059604644775390625000001";
+  float f = 0;
+  auto r = toby::from_chars(text.data(), text.data() + text.size(), f);
+  REQUIRE(r.ec == std::errc());
+  REQUIRE(r.ptr == text.data() + text.size());
+  REQUIRE(f == 1.00000011920928955078125f);
+
+  const std::string exact = "-12.5e-1";
+  r = toby::from_chars(exact.data(), exact.data() + exact.size(), f);
+  REQUIRE(f == -1.25f);
+
+  // An exponent takes one sign, and a huge one saturates.
+  const std::string two_signs = "1e--5";
+  r = toby::from_chars(two_signs.data(), two_signs.data() + two_signs.size(),
+                       f);
+  REQUIRE(r.ec == std::errc());
+  REQUIRE(r.ptr == two_signs.data() + 1);
+  REQUIRE(f == 1.0f);
+  double d = 1;
+  const std::string tiny = "1e-99999999999999999999999";
+  r = toby::from_chars(tiny.data(), tiny.data() + tiny.size(), d);
+  REQUIRE(r.ec == std::errc());
+  REQUIRE(r.ptr == tiny.data() + tiny.size());
+  REQUIRE(d == 0);
+  const std::string huge = "1e99999999999999999999999";
+  r = toby::from_chars(huge.data(), huge.data() + huge.size(), d);
+  REQUIRE(r.ec == std::errc::result_out_of_range);
+}
+
+TEST_CASE("a packed variant stream stores each element at its own size",
+          "[variant][packed]") {
+  toby::packed_variant_stream<char, double, std::string> stream;
+  for (int i = 0; i < 1000; ++i) {
+    stream.push('x');
+  }
+  REQUIRE(stream.size() == 1000);
+  REQUIRE(stream.bytes() == 2000);
+
+  stream.push(1.5);
+  stream.push(variant<char, double, std::string>(std::string(100, 'y')));
+  stream.emplace<std::string>(3, 'z');
+  REQUIRE(stream.bytes() == 2000 + 16 + 2 * (8 + sizeof(std::string)));
+
+  std::string text;
+  double sum = 0;
+  for (auto v : stream) {
+    v.visit<void>([&](char c) { text += c; }, [&](double d) { sum += d; },
+                  [&](const std::string& s) { text += s; });
+  }
+  REQUIRE(text == std::string(1000, 'x') + std::string(100, 'y') + "zzz");
+  REQUIRE(sum == 1.5);
+}
+TEST_CASE("a packed variant stream relocates and destroys its elements",
+          "[variant][packed]") {
+  counts = {};
+  {
+    toby::packed_variant_stream<int, special_member_counter> stream;
+    for (int i = 0; i < 100; ++i) {
+      stream.push(i);
+      stream.emplace<special_member_counter>();
+    }
+    REQUIRE(counts.num_default_constructor == 100);
+    REQUIRE(counts.num_move_constructor > 0);
+    REQUIRE(counts.num_destructor == counts.num_move_constructor);
+    REQUIRE(std::distance(stream.begin(), stream.end()) == 200);
+  }
+  REQUIRE(counts.num_copy_constructor == 0);
+  REQUIRE(counts.num_destructor ==
+          counts.num_default_constructor + counts.num_move_constructor);
+}
+
+TEST_CASE("compressed streams round-trip runs of variants",
+          "[variant][compress]") {
+  using message = variant<int, double, std::string>;
+  std::vector<message> messages;
+  for (int i = 0; i < 100; ++i) {
+    messages.push_back(1000 - i);
+  }
+  for (int i = 0; i < 100; ++i) {
+    messages.push_back(90.0 + (i / 10) * 0.5);
+  }
+  messages.push_back(std::string("hello"));
+  messages.push_back(-7);
+
+  std::string out;
+  toby::compressed_encoder<message> encoder(out);
+  for (const auto& m : messages) {
+    encoder.push(m);
+  }
+  encoder.flush();
+  // Runs of small deltas take about a byte each.
+  REQUIRE(out.size() < 300);
+
+  toby::compressed_decoder<message> decoder(out.data(), out.size());
+  for (const auto& expected : messages) {
+    REQUIRE_FALSE(decoder.empty());
+    auto m = decoder.next();
+    REQUIRE(m.tag == expected.tag);
+    std::ostringstream decoded, original;
+    decoded << m;
+    original << expected;
+    REQUIRE(decoded.str() == original.str());
+  }
+  REQUIRE(decoder.empty());
+
+  // The destructor writes the last run.
+  std::string unflushed;
+  {
+    toby::compressed_encoder<message> e(unflushed);
+    e.push(message(42));
+  }
+  toby::compressed_decoder<message> last(unflushed.data(), unflushed.size());
+  REQUIRE(last.next().tag == 0);
+  REQUIRE(last.empty());
+
+  // A bad tag, an empty run, a bad floating point header and an endless
+  // varint.
+  const std::string corrupt[] = {
+      std::string("\x03\x01", 2), std::string("\x00\x00", 2),
+      std::string("\x01\x01\xff", 3), std::string(11, '\x80')};
+  for (const auto& c : corrupt) {
+    toby::compressed_decoder<message> d(c.data(), c.size());
+    REQUIRE_THROWS_AS(d.next(), const toby::deserialize_error&);
+  }
+
+  // A bad run header does not leave a run behind to decode.
+  toby::compressed_decoder<message> bad_run("\x03\x02", 2);
+  REQUIRE_THROWS_AS(bad_run.next(), const toby::deserialize_error&);
+  REQUIRE(bad_run.empty());
+}
+
+TEST_CASE("an spsc ring hands elements between two threads in order",
+          "[spsc_ring]") {
+  toby::spsc_ring<variant<int, std::string>> ring(8);
+  REQUIRE_THROWS_AS(toby::spsc_ring<int>(6), const std::invalid_argument&);
+
+  const int n = 100000;
+  std::thread producer([&] {
+    for (int i = 0; i < n; ++i) {
+      while (!(i % 10 ? ring.try_push(i) : ring.try_push(std::to_string(i)))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  int expected = 0;
+  bool in_order = true;
+  while (expected < n) {
+    auto consumed = ring.consume(
+        [&](variant<int, std::string>&& v) {
+          in_order = in_order &&
+                     v.visit<int>([](int i) { return i; },
+                                  [](const std::string& s) {
+                                    return std::stoi(s);
+                                  }) == expected;
+          ++expected;
+        },
+        4);
+    if (consumed == 0) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  REQUIRE(in_order);
+}
+TEST_CASE("a sharded runtime applies every event to its object",
+          "[sharded_runtime]") {
+  auto add = [](int s, int e) { return s + e; };
+  const std::size_t objects = 1000;
+  toby::sharded_runtime<int, int, decltype(add)> runtime(objects, 3, 2, 0,
+                                                          add, 16);
+  REQUIRE_THROWS_AS(runtime.make_producer(2), const std::out_of_range&);
+  REQUIRE_THROWS_AS(runtime.make_producer(0).try_send(objects, 1),
+                    const std::out_of_range&);
+  std::vector<std::thread> producers;
+  for (std::size_t p = 0; p < 2; ++p) {
+    producers.emplace_back([&runtime, p] {
+      auto producer = runtime.make_producer(p);
+      for (int round = 1; round <= 10; ++round) {
+        for (std::size_t id = 0; id < objects; ++id) {
+          producer.send(id, round);
+        }
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  runtime.stop();
+  REQUIRE(runtime.processed() == 2 * 10 * objects);
+  bool all = true;
+  for (std::size_t id = 0; id < objects; ++id) {
+    all = all && runtime.state(id) == 110;
+  }
+  REQUIRE(all);
+}
+
+TEST_CASE("parallel_visit and parallel_reduce cover every element once",
+          "[parallel]") {
+  std::vector<variant<int, std::string>> values;
+  for (int i = 0; i < 10000; ++i) {
+    if (i % 7) {
+      values.push_back(i);
+    } else {
+      values.push_back(std::to_string(i));
+    }
+  }
+  struct {
+    std::int64_t operator()(int i) const { return i; }
+    std::int64_t operator()(const std::string& s) const {
+      return std::stoi(s);
+    }
+  } value;
+  auto plus = [](std::int64_t a, std::int64_t b) { return a + b; };
+
+  toby::thread_pool pool(4);
+  REQUIRE(pool.size() == 4);
+  REQUIRE(toby::parallel_reduce(pool, values.begin(), values.end(),
+                                std::int64_t(0), value, plus) ==
+          std::int64_t(9999) * 10000 / 2);
+  REQUIRE(toby::parallel_reduce(values, std::int64_t(0), value, plus) ==
+          std::int64_t(9999) * 10000 / 2);
+
+  // Partial results are combined in index order, so combine need not be
+  // commutative.
+  std::vector<std::int64_t> expected(values.size());
+  std::iota(expected.begin(), expected.end(), 0);
+  auto single = [&](const auto& x) {
+    return std::vector<std::int64_t>{value(x)};
+  };
+  auto concat = [](std::vector<std::int64_t> a,
+                   const std::vector<std::int64_t>& b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+  };
+  bool ordered = true;
+  for (int run = 0; run < 20; ++run) {
+    ordered = ordered &&
+              toby::parallel_reduce(pool, values.begin(), values.end(),
+                                    std::vector<std::int64_t>(), single,
+                                    concat) == expected;
+  }
+  REQUIRE(ordered);
+
+  std::vector<std::atomic<int>> seen(values.size());
+  toby::parallel_visit(pool, values.begin(), values.end(), [&](auto&& x) {
+    ++seen[static_cast<std::size_t>(value(x))];
+  });
+  bool once = true;
+  for (auto& n : seen) {
+    once = once && n == 1;
+  }
+  REQUIRE(once);
+
+  REQUIRE_THROWS_AS(
+      toby::parallel_visit(pool, values.begin(), values.end(),
+                           [](const auto&) { throw std::runtime_error("x"); }),
+      const std::runtime_error&);
+}
+
+TEST_CASE("a tag table applies transitions like the multivisitor",
+          "[tag_table]") {
+  REQUIRE(transition_tags::entry(0, 0) == 1);
+  REQUIRE(transition_tags::entry(2, 0) == transition_tags::unchanged);
+  REQUIRE(transition_tags::entry(2, 4) == transition_tags::needs_transition);
+
+  const std::vector<state> states = {off{}, idle{}, turning{10},
+                                     turning{20}};
+  const std::vector<event> events = {
+      turn_on{}, turn_off{}, start_turning{20}, reset{"watchdog"},
+      heading_changed{20}, heading_changed{30}};
+  std::vector<state> expected;
+  std::vector<state> actual;
+  std::vector<event> applied;
+  // Enough pairs to fill several blocks and vectors, with a tail.
+  for (int round = 0; round < 7; ++round) {
+    for (const auto& s : states) {
+      for (const auto& e : events) {
+        expected.push_back(transition(s, e));
+        actual.push_back(s);
+        applied.push_back(e);
+      }
+    }
+  }
+  transition_tags::apply(actual.data(), applied.data(), actual.size(),
+                         transition);
+  auto target = [](const state& s) {
+    return s.visit<float>([](turning t) { return t.target; },
+                          [](const auto&) { return -1.f; });
+  };
+  bool same = true;
+  for (std::size_t i = 0; i < actual.size(); ++i) {
+    same = same && actual[i].tag == expected[i].tag &&
+           target(actual[i]) == target(expected[i]);
+  }
+  REQUIRE(same);
+}
+
+TEST_CASE("a tag table destroys the payload it replaces", "[tag_table]") {
+  struct stop {};
+  using machine = variant<stop, std::string>;
+  using command = variant<stop, std::string>;
+  using table = toby::tag_table<machine, command,
+                                toby::tag_rule<toby::any_alternative, stop,
+                                               stop>>;
+  std::vector<machine> machines(3, std::string(100, 'x'));
+  std::vector<command> commands = {stop{}, std::string("go"), stop{}};
+  table::apply(machines.data(), commands.data(), machines.size(),
+               [](const machine&, const command& c) { return c; });
+  REQUIRE(machines[0].tag == 0);
+  REQUIRE(machines[1].visit<std::string>(
+              [](stop) { return std::string(); },
+              [](const std::string& s) { return s; }) == "go");
+  REQUIRE(machines[2].tag == 0);
+}
+
+TEST_CASE("an updater touches the state only when it changes", "[updater]") {
+  struct tick {};
+  struct stop {};
+  using machine = variant<special_member_counter, int>;
+  using command = variant<tick, stop>;
+  machine m(special_member_counter{});
+  const command t(tick{});
+  const command s(stop{});
+
+  // Returning the state as it was copies it and move-assigns it back.
+  counts = {};
+  m = make_multivisitor<machine>(
+      [](const special_member_counter& c, tick) -> machine { return c; },
+      [](const auto&, const auto&) -> machine { return 0; })(m, t);
+  REQUIRE(counts.num_copy_constructor == 1);
+  REQUIRE(counts.num_move_constructor == 1);
+  REQUIRE(counts.num_destructor == 2);
+
+  auto update = toby::make_updater(
+      [](special_member_counter&, tick) { return toby::unchanged{}; },
+      [](special_member_counter&, stop) { return 0; },
+      [](int& i, tick) {
+        ++i;
+        return toby::unchanged{};
+      },
+      [](int&, stop) { return 0; });
+  counts = {};
+  update(m, t);
+  REQUIRE(counts.num_default_constructor == 0);
+  REQUIRE(counts.num_copy_constructor == 0);
+  REQUIRE(counts.num_move_constructor == 0);
+  REQUIRE(counts.num_copy_assignment == 0);
+  REQUIRE(counts.num_move_assignment == 0);
+  REQUIRE(counts.num_destructor == 0);
+
+  update(m, s);
+  REQUIRE(counts.num_destructor == 1);
+  update(m, t);
+  update(m, t);
+  REQUIRE(m.visit<int>([](int i) { return i; },
+                       [](const special_member_counter&) { return -1; }) ==
+          2);
+  update(m, s);
+  REQUIRE(m.visit<int>([](int i) { return i; },
+                       [](const special_member_counter&) { return -1; }) ==
+          0);
+}
+
+TEST_CASE("update applies events like transition", "[updater]") {
+  // Every alternative of each, with headings near and far from the target.
+  const std::vector<state> states = {off{}, idle{}, turning{10},
+                                     turning{20}};
+  const std::vector<event> events = {
+      turn_on{}, turn_off{}, start_turning{20}, reset{"watchdog"},
+      heading_changed{20}, heading_changed{20.05f}, heading_changed{30}};
+  auto target = [](const state& s) {
+    return s.visit<float>([](turning t) { return t.target; },
+                          [](const auto&) { return -1.f; });
+  };
+  for (const auto& s : states) {
+    for (const auto& e : events) {
+      auto expected = transition(s, e);
+      auto actual = s;
+      update(actual, e);
+      INFO("state " << s.tag << ", event " << e.tag);
+      REQUIRE(actual.tag == expected.tag);
+      REQUIRE(target(actual) == target(expected));
+    }
+  }
+}
+
+TEST_CASE("a bound multivisitor dispatches on the remaining arguments",
+          "[multivisitor]") {
+  auto visitor = make_multivisitor<std::string>(
+      [](int, int) { return std::string("int int"); },
+      [](int, const std::string&) { return std::string("int string"); },
+      [](const std::string&, const auto&) { return std::string("string"); });
+  variant<int, std::string> first(1);
+  std::vector<std::string> results;
+  visitor.bind_first(first, [&](const auto& bound) {
+    results.push_back(bound(variant<int, std::string>(2)));
+    results.push_back(bound(variant<int, std::string>(std::string("x"))));
+  });
+  REQUIRE(results == std::vector<std::string>({"int int", "int string"}));
+}
+
+TEST_CASE("dispatch_many applies events like repeated transitions",
+          "[multivisitor][dispatch_many]") {
+  const std::vector<event> events = {
+      turn_on{},           heading_changed{1},  start_turning{90},
+      heading_changed{10}, start_turning{180},  heading_changed{180},
+      heading_changed{5},  reset{"watchdog"},   start_turning{45},
+      turn_off{},          heading_changed{45}, turn_on{}};
+  for (const auto& initial : {state(off{}), state(idle{}), state(turning{5})}) {
+    state expected = initial;
+    for (const auto& e : events) {
+      expected = transition(expected, e);
+    }
+    state actual = initial;
+    dispatch_many(actual, events);
+    REQUIRE(actual.tag == expected.tag);
+  }
+
+  state s = idle{};
+  dispatch_many(s, toby::span<const event>(events.data(), 3));
+  REQUIRE(s.visit<float>([](turning t) { return t.target; },
+                         [](const auto&) { return -1.f; }) == 90);
+}
+
+TEST_CASE("a coalescing queue merges repeats at its back",
+          "[coalescing_queue]") {
+  toby::coalescing_queue<event> queue;
+  REQUIRE(queue.push(heading_changed{1}));
+  REQUIRE_FALSE(queue.push(heading_changed{2}));
+  REQUIRE(queue.push(event(turn_on{})));
+  REQUIRE_FALSE(queue.push(event(turn_on{})));
+  REQUIRE(queue.push(heading_changed{3}));
+  REQUIRE(queue.push(reset{"a"}));
+  REQUIRE(queue.push(reset{"a"}));
+  REQUIRE(queue.push(start_turning{1}));
+  REQUIRE_FALSE(queue.push(start_turning{2}));
+  REQUIRE(queue.size() == 6);
+  REQUIRE(queue.merged() == 3);
+  REQUIRE(queue.peak() == 6);
+
+  std::vector<std::string> consumed;
+  REQUIRE(queue.consume([&](event&& e) {
+    std::ostringstream os;
+    os << e;
+    consumed.push_back(os.str());
+  }) == 6);
+  REQUIRE(consumed ==
+          std::vector<std::string>(
+              {"variant[4]: heading_changed{2}", "variant[0]: turn_on{}",
+               "variant[4]: heading_changed{3}", "variant[3]: reset{a}",
+               "variant[3]: reset{a}", "variant[2]: start_turning{2}"}));
+  REQUIRE(queue.empty());
+  REQUIRE(queue.push(heading_changed{4}));
+}
+
+TEST_CASE("merging headings can keep a robot turning past its target",
+          "[coalescing_queue]") {
+  // The robot passes its target between two reports.  Applied one by one,
+  // the first report stops it; merged, only the second is seen.
+  const std::vector<event> reports = {heading_changed{90.05f},
+                                      heading_changed{95}};
+  state one_by_one = turning{90};
+  for (const auto& e : reports) {
+    one_by_one = transition(one_by_one, e);
+  }
+  REQUIRE(one_by_one.tag == 1);
+
+  toby::coalescing_queue<event> queue;
+  for (const auto& e : reports) {
+    queue.push(e);
+  }
+  state merged = turning{90};
+  queue.consume([&](event&& e) { merged = transition(merged, e); });
+  REQUIRE(merged.tag == 2);
+
+  // The next report close to the target stops it.
+  merged = transition(merged, heading_changed{90});
+  REQUIRE(merged.tag == 1);
+}
+
+TEST_CASE("a lane queue serves urgent lanes first without starving others",
+          "[lane_queue]") {
+  toby::lane_queue<event> queue(2);
+  REQUIRE(toby::lane_queue<event>::lanes == 2);
+  for (int i = 0; i < 5; ++i) {
+    queue.push(heading_changed{static_cast<float>(i)});
+  }
+  for (int i = 0; i < 4; ++i) {
+    queue.push(event(turn_off{}));
+  }
+  REQUIRE(queue.size() == 9);
+  REQUIRE(queue.stats(0).depth == 5);
+  REQUIRE(queue.stats(1).depth == 4);
+
+  std::string order;
+  auto taken = queue.consume(
+      [&](event&& e) { order += e.tag == 1 ? 'o' : 'h'; }, 100);
+  REQUIRE(taken == 9);
+  REQUIRE(order == "oohoohhhh");
+  REQUIRE(queue.empty());
+  REQUIRE(queue.stats(0).popped == 5);
+  REQUIRE(queue.stats(0).peak_depth == 5);
+  REQUIRE(queue.stats(1).latency.count() == 4);
+  REQUIRE(queue.stats(1).latency.percentile(0.99) <=
+          queue.stats(0).latency.percentile(1));
+}
+
+struct background {};
+struct routine {};
+struct urgent {};
+
+namespace toby {
+template <>
+struct priority_lane<routine> : std::integral_constant<std::size_t, 1> {};
+template <>
+struct priority_lane<urgent> : std::integral_constant<std::size_t, 2> {};
+}  // namespace toby
+
+TEST_CASE("a lane queue does not starve its lowest lane", "[lane_queue]") {
+  using job = variant<background, routine, urgent>;
+  toby::lane_queue<job> queue(2);
+  REQUIRE(toby::lane_queue<job>::lanes == 3);
+  for (int i = 0; i < 2; ++i) {
+    queue.push(background{});
+  }
+  for (int i = 0; i < 4; ++i) {
+    queue.push(routine{});
+  }
+  for (int i = 0; i < 6; ++i) {
+    queue.push(urgent{});
+  }
+
+  std::string order;
+  queue.consume([&](job&& j) { order += "bru"[j.tag]; }, 100);
+  REQUIRE(order == "uubrubruurur");
+}
+
+TEST_CASE("a lane queue keeps an event whose consumer throws",
+          "[lane_queue]") {
+  toby::lane_queue<event> queue;
+  queue.push(event(turn_on{}));
+  queue.push(event(turn_off{}));
+  REQUIRE_THROWS_AS(queue.consume(
+                        [](event&&) { throw std::runtime_error("busy"); }, 1),
+                    const std::runtime_error&);
+  REQUIRE(queue.size() == 2);
+  REQUIRE(queue.stats(1).depth == 1);
+  REQUIRE(queue.stats(1).popped == 0);
+
+  // The consumer may push follow-up events.
+  std::string order;
+  queue.consume(
+      [&](event&& e) {
+        order += std::to_string(e.tag);
+        if (e.tag == 1) {
+          queue.push(event(reset{"again"}));
+        }
+      },
+      100);
+  REQUIRE(order == "130");
+  REQUIRE(queue.empty());
+  REQUIRE(queue.stats(1).popped == 2);
+}
+
+TEST_CASE("a latency histogram keeps percentiles within a quarter",
+          "[lane_queue]") {
+  toby::latency_histogram h;
+  REQUIRE(h.percentile(0.5) == 0);
+  for (std::uint64_t ns = 1; ns <= 1000; ++ns) {
+    h.record(ns);
+  }
+  REQUIRE(h.count() == 1000);
+  REQUIRE(h.percentile(0.5) >= 500);
+  REQUIRE(h.percentile(0.5) <= 625);
+  REQUIRE(h.percentile(0.99) >= 990);
+  REQUIRE(h.percentile(1) >= 1000);
+  REQUIRE(h.percentile(1) <= 1250);
+}
+
+TEST_CASE("an mpsc ring keeps each producer's elements in order",
+          "[mpsc_ring]") {
+  toby::mpsc_ring<variant<int, std::string>> ring(16);
+  REQUIRE_THROWS_AS(toby::mpsc_ring<variant<int>>(12),
+                    const std::invalid_argument&);
+
+  const int producers = 4;
+  const int n = 20000;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&ring, p] {
+      for (int i = 0; i < n; ++i) {
+        auto value = i * producers + p;
+        while (!(i % 3 ? ring.try_push(value)
+                       : ring.try_emplace<std::string>(
+                             std::to_string(value)))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::vector<int> next(producers, 0);
+  bool in_order = true;
+  for (int received = 0; received < producers * n;) {
+    auto consumed = ring.consume(
+        toby::make_overload_set(
+            [&](int value) {
+              in_order = in_order && value / producers ==
+                                         next[value % producers]++;
+            },
+            [&](std::string&& s) {
+              auto value = std::stoi(s);
+              in_order = in_order && value / producers ==
+                                         next[value % producers]++;
+            }),
+        8);
+    if (consumed == 0) {
+      std::this_thread::yield();
+    }
+    received += static_cast<int>(consumed);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  REQUIRE(in_order);
+}
+
+TEST_CASE("an mpsc ring of trivially copyable variants copies bytes",
+          "[mpsc_ring]") {
+  toby::mpsc_ring<variant<int, double>> ring(2);
+  REQUIRE(ring.try_push(variant<int, double>(1.5)));
+  REQUIRE(ring.try_push(2));
+  REQUIRE_FALSE(ring.try_push(3));
+  variant<int, double> v(0);
+  REQUIRE(ring.try_pop(v));
+  REQUIRE(v.visit<double>([](auto x) { return static_cast<double>(x); }) ==
+          1.5);
+  REQUIRE(ring.try_pop(v));
+  REQUIRE(v.tag == 0);
+  REQUIRE_FALSE(ring.try_pop(v));
+}
+
+struct flaky {
+  explicit flaky(bool fail) {
+    if (fail) {
+      throw std::runtime_error("flaky");
+    }
+  }
+};
+
+TEST_CASE("an mpsc ring skips an element whose constructor threw",
+          "[mpsc_ring]") {
+  toby::mpsc_ring<variant<int, flaky>> ring(2);
+  REQUIRE_THROWS_AS(ring.try_emplace<flaky>(true), const std::runtime_error&);
+  REQUIRE(ring.try_push(1));
+  REQUIRE_FALSE(ring.try_push(2));
+  variant<int, flaky> v(0);
+  REQUIRE(ring.try_pop(v));
+  REQUIRE(v.visit<int>([](int i) { return i; },
+                       [](const flaky&) { return -1; }) == 1);
+  REQUIRE_FALSE(ring.try_pop(v));
+  REQUIRE(ring.try_emplace<flaky>(false));
+  REQUIRE(ring.try_push(3));
+  REQUIRE(ring.consume([&](auto&&) {}, 2) == 2);
+}
+
 auto variant_logger = ::spdlog::stderr_logger_st("variant", true);
@@ -0,0 +1,275 @@
+#include "event.hpp"
+#include "event_log.hpp"
+#include "mapped_file.hpp"
+#include "robot.hpp"
+#include "robot_io.hpp"
+#include "robot_protocol.hpp"
+#include "serialize.hpp"
+#include "shared_ring.hpp"
+#include "unix_socket.hpp"
+#include "variant.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <dirent.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Tests of files, shared memory, processes and sockets, which need POSIX and
+// so are kept out of test_multivisitor.
+
+using toby::variant;
+
+// A file under /tmp, removed when the test ends even if a REQUIRE fails.
+class temp_file {
+ private:
+  std::string m_name;
+
+ public:
+  temp_file() {
+    char name[] = "/tmp/test_posixXXXXXX";
+    int fd = ::mkstemp(name);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "mkstemp");
+    }
+    ::close(fd);
+    m_name = name;
+  }
+  temp_file(const temp_file&) = delete;
+  temp_file& operator=(const temp_file&) = delete;
+  ~temp_file() { std::remove(m_name.c_str()); }
+
+  const std::string& name() const { return m_name; }
+};
+
+// A directory under /tmp, removed with the files in it when the test ends.
+class temp_dir {
+ private:
+  std::string m_name;
+
+ public:
+  temp_dir() {
+    char name[] = "/tmp/test_posixXXXXXX";
+    if (!::mkdtemp(name)) {
+      throw std::system_error(errno, std::generic_category(), "mkdtemp");
+    }
+    m_name = name;
+  }
+  temp_dir(const temp_dir&) = delete;
+  temp_dir& operator=(const temp_dir&) = delete;
+  ~temp_dir() {
+    if (auto dir = ::opendir(m_name.c_str())) {
+      while (auto entry = ::readdir(dir)) {
+        std::string file = entry->d_name;
+        if (file != "." && file != "..") {
+          std::remove((m_name + "/" + file).c_str());
+        }
+      }
+      ::closedir(dir);
+    }
+    ::rmdir(m_name.c_str());
+  }
+
+  const std::string& name() const { return m_name; }
+};
+
+TEST_CASE("serialized variants can be viewed in a mapped file",
+          "[variant][serialize]") {
+  using message = variant<turn_on, start_turning, reset>;
+  temp_file path;
+  {
+    std::ofstream file(path.name(), std::ios::binary);
+    file << toby::serialize(message(reset{"brownout"}))
+         << toby::serialize(message(start_turning{90}));
+  }
+
+  toby::mapped_file file(path.name());
+  toby::reader r(file.data(), file.size());
+  auto first = toby::deserialize_view<message>(r);
+  REQUIRE(first.tag == 2);
+  first.visit<void>(
+      [&](const reset_view& e) {
+        REQUIRE(e.reason == "brownout");
+        REQUIRE(e.reason.data() >= file.data());
+        REQUIRE(e.reason.data() < file.data() + file.size());
+      },
+      [](const auto&) { FAIL("expected a reset"); });
+  REQUIRE(toby::deserialize_view<message>(r).tag == 1);
+  REQUIRE(r.empty());
+}
+
+TEST_CASE("an event log replays from its latest snapshot",
+          "[variant][event_log]") {
+  using message = variant<int, std::string>;
+  temp_dir dir;
+  int applied = 0;
+  auto sum = [&applied](int s, const message& m) {
+    ++applied;
+    return s + m.visit<int>([](int i) { return i; },
+                            [](const std::string& s) {
+                              return static_cast<int>(s.size());
+                            });
+  };
+
+  {
+    toby::event_log<message> log(dir.name(), 16);
+    for (int i = 1; i <= 10; ++i) {
+      log.append(i);
+    }
+    log.append(std::string("abc"));
+    log.flush();
+    REQUIRE(toby::replay<message>(dir.name(), 0, sum) == 58);
+    REQUIRE(applied == 11);
+    log.snapshot(58);
+    log.append(100);
+  }
+  {
+    toby::event_log<message> log(dir.name(), 16);
+    REQUIRE(log.size() == 12);
+    log.append(std::string("de"));
+  }
+  applied = 0;
+  REQUIRE(toby::replay<message>(dir.name(), 0, sum) == 160);
+  REQUIRE(applied == 2);
+}
+
+TEST_CASE("a shared ring carries variants between two processes",
+          "[shared_ring]") {
+  using message = variant<int, double>;
+  const std::string name = "/toby-test-" + std::to_string(::getpid());
+  toby::shared_memory::unlink(name);
+  auto ring = toby::shared_ring<message>::create(name, 8);
+  using other = toby::shared_ring<variant<int, char>>;
+  REQUIRE_THROWS_AS(other::open(name), const std::runtime_error&);
+
+  const int n = 10000;
+  auto child = ::fork();
+  REQUIRE(child >= 0);
+  if (child == 0) {
+    // The child must not return into Catch, whatever happens.
+    try {
+      // A separate mapping, likely at another address.
+      auto producer = toby::shared_ring<message>::open(name);
+      for (int i = 0; i < n; ++i) {
+        while (!(i % 2 ? producer.try_emplace<int>(i)
+                       : producer.try_push(message(i + .5)))) {
+          std::this_thread::yield();
+        }
+      }
+    } catch (...) {
+      ::_exit(1);
+    }
+    ::_exit(0);
+  }
+
+  // Stop waiting if the child dies or stalls.
+  int expected = 0;
+  bool in_order = true;
+  int status = 0;
+  bool exited = false;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (expected < n) {
+    auto consumed = ring.consume(
+        [&](const auto& value) {
+          in_order = in_order && static_cast<int>(value) == expected;
+          ++expected;
+        },
+        4);
+    if (consumed == 0) {
+      if (exited || std::chrono::steady_clock::now() > deadline) {
+        break;
+      }
+      exited = ::waitpid(child, &status, WNOHANG) == child;
+      std::this_thread::yield();
+    }
+  }
+  if (!exited) {
+    if (expected < n) {
+      ::kill(child, SIGKILL);
+    }
+    ::waitpid(child, &status, 0);
+  }
+  toby::shared_memory::unlink(name);
+  REQUIRE(expected == n);
+  REQUIRE(in_order);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+
+#ifdef __linux__
+  auto anonymous = toby::shared_ring<message>::create_anonymous(4);
+  auto attached = toby::shared_ring<message>::attach(anonymous.fd());
+  REQUIRE(attached.try_push(7));
+  message m(0.);
+  REQUIRE(anonymous.try_pop(m));
+  REQUIRE(m.tag == 0);
+
+  // An element with a corrupt tag is dropped rather than visited.
+  message corrupt(1);
+  corrupt.tag = 2;
+  REQUIRE(attached.try_push(corrupt));
+  corrupt.tag = 0;
+  REQUIRE(attached.try_push(2.5));
+  REQUIRE(anonymous.try_pop(m));
+  REQUIRE(m.tag == 1);
+  REQUIRE(!anonymous.try_pop(m));
+
+  // The capacity follows the magic number and layout hash in the header.
+  auto memory = toby::shared_memory::attach(anonymous.fd());
+  for (std::uint64_t capacity : {std::uint64_t(3), std::uint64_t(1) << 62}) {
+    std::memcpy(memory.data() + 16, &capacity, sizeof(capacity));
+    REQUIRE_THROWS_AS(toby::shared_ring<message>::attach(anonymous.fd()),
+                      const std::runtime_error&);
+  }
+#endif
+}
+
+TEST_CASE("unix_datagram_socket receives queued datagrams in one batch",
+          "[unix_socket]") {
+  auto sockets = toby::unix_datagram_socket::pair();
+  std::string datagram;
+  protocol::begin(datagram, protocol::message_kind::events);
+  protocol::append_event(datagram, 7, turn_on{});
+  protocol::append_event(datagram, 9, reset{"stuck"});
+  sockets.first.send(datagram.data(), datagram.size());
+  protocol::make_query(datagram, 7, 42);
+  sockets.first.send(datagram.data(), datagram.size());
+
+  toby::datagram_batch batch(8);
+  REQUIRE(sockets.second.receive(batch) == 2);
+  REQUIRE(batch.size() == 2);
+
+  auto data = batch.data(0);
+  toby::reader r(data.data(), data.size());
+  REQUIRE(protocol::read_kind(r) == protocol::message_kind::events);
+  REQUIRE(toby::deserialize<std::uint32_t>(r) == 7);
+  REQUIRE(toby::deserialize<event>(r).tag == 0);
+  REQUIRE(toby::deserialize<std::uint32_t>(r) == 9);
+  auto reason = toby::deserialize<event>(r).visit<std::string>(
+      [](const reset& e) { return e.reason; },
+      [](const auto&) { return std::string(); });
+  REQUIRE(reason == "stuck");
+  REQUIRE(r.empty());
+
+  data = batch.data(1);
+  r = toby::reader(data.data(), data.size());
+  REQUIRE(protocol::read_kind(r) == protocol::message_kind::query);
+  REQUIRE(toby::deserialize<std::uint32_t>(r) == 7);
+  REQUIRE(toby::deserialize<std::uint64_t>(r) == 42);
+
+  sockets.second.set_receive_timeout(std::chrono::milliseconds(1));
+  REQUIRE(sockets.second.receive(batch) == 0);
+}
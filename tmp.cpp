@@ -1,39 +1,11 @@
-#include "event.hpp"
-#include "multivisitor.hpp"
-#include "state.hpp"
-#include "variant.hpp"
+#include "robot.hpp"
 
-#include <cmath>
 #include <iostream>
+#include <string>
 #include <utility>
+#include <vector>
 
 using toby::variant;
-using toby::make_multivisitor;
-
-using state = variant<off, idle, turning>;
-using on = variant<idle, turning>;
-
-using event = variant<turn_on, turn_off, start_turning, reset, heading_changed>;
-
-// clang-format off
-state transition(const state& s, const event& e) {
-  return make_multivisitor<state>(
-      [](off,       turn_on)         { return idle{}; },
-      [](off,       const auto&)     { return off{}; },
-      [](on,        turn_off)        { return off{}; },
-      [](auto s,    turn_on)         { return s; },
-      [](on,        reset)           { return idle{}; },
-      [](on,        start_turning e) { return turning{e.target}; },
-      [](idle s,    heading_changed) { return s; },
-      [](turning s, heading_changed e) -> state {
-        if (std::abs(e.heading - s.target) < .1f) {
-          return idle{};
-        } else {
-          return s;
-        }
-      })(s, e);
-}
-// clang-format on
 
 using empty_variant = variant<>;
 
@@ -64,12 +36,10 @@ int main() {
       "temporary event");
   s = transition(s, start_turning{42});
   logger->info("state = {}", s);
-  logger->info(
-      "calling transition with temporary event "
-      "from "
-      "temporary event");
-  s = transition(s, heading_changed{101});
+  logger->info("updating in place with an event that changes nothing");
+  update(s, heading_changed{101});
   logger->info("state = {}", s);
-  s = transition(s, heading_changed{42});
+  logger->info("updating in place with an event that changes the state");
+  update(s, heading_changed{42});
   logger->info("state = {}", s);
 }